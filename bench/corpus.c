@@ -0,0 +1,476 @@
+/**
+ * @file corpus.c
+ * @author Devin Arena
+ * @brief Benchmark over a synthetic corpus. Documents of several shapes (deep
+ * container chains, dense macro use, long text) are generated at doubling
+ * sizes and each phase of a build (read, scan, compile, write) is timed on
+ * them, so anything that grows faster than the input shows up as a ratio
+ * above 2 between one size and the next. The compiler pulls its tokens from
+ * the scanner as it goes, so compile includes scanning.
+ * @since 12/5/2022
+ **/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../src/arena.h"
+#include "../src/builder.h"
+#include "../src/chtml.h"
+#include "../src/scanner.h"
+#include "../src/source.h"
+#include "../src/timer.h"
+#include "../src/tokens.h"
+
+#define CORPUS_DIR "build/corpus"
+#define OUTPUT_PATH "build/corpus/bench-corpus.html"
+// the smallest document, each shape doubles from here up to the maximum
+#define MIN_SIZE (256 * 1024)
+#define DEFAULT_MAX_SIZE (16 * 1024 * 1024)
+#define DEFAULT_ROUNDS 5
+// macros a document defines, uses pick among them
+#define MACRO_COUNT 16
+// a phase taking this much longer when its input doubles is reported, once
+// it takes long enough for the timing to mean something
+#define SUPERLINEAR_RATIO 2.3
+#define SUPERLINEAR_MIN_MILLIS 1.0
+
+typedef struct {
+  const char* name;
+  // containers each block is nested in
+  int depth;
+  // share of blocks that call a macro instead of writing their own content
+  int macroPercent;
+  // characters of text in each paragraph
+  int textLength;
+} CorpusShape;
+
+static const CorpusShape shapes[] = {
+    {"flat", 1, 0, 40},
+    {"deep", 64, 0, 40},
+    {"macros", 2, 75, 40},
+    {"text", 1, 0, 4000},
+};
+
+typedef enum {
+  PHASE_READ,
+  PHASE_SCAN,
+  PHASE_COMPILE,
+  PHASE_WRITE,
+  PHASE_COUNT,
+} Phase;
+
+static const char* phaseNames[PHASE_COUNT] = {"read", "scan", "compile",
+                                              "write"};
+
+typedef struct {
+  double millis;
+  long peakKib;
+} PhaseResult;
+
+/**
+ * @brief Appends text of a given length made of ordinary words, with the odd
+ * character that has to be escaped.
+ *
+ * @param source StringBuilder* where to write the text.
+ * @param length int how many characters to write.
+ * @param seed unsigned varies the words chosen.
+ */
+static void appendText(StringBuilder* source, int length, unsigned seed) {
+  static const char* words[] = {"lorem", "ipsum", "dolor", "sit", "amet",
+                                "consectetur", "adipiscing", "elit", "sed",
+                                "do", "eiusmod", "tempor", "&", "<b>"};
+  int count = sizeof(words) / sizeof(words[0]);
+  size_t end = source->length + length;
+  while (source->length < end) {
+    seed = seed * 1103515245 + 12345;
+    builderAppendString(source, words[(seed >> 16) % count]);
+    builderAppend(source, " ", 1);
+  }
+  // the last word is cut short to hit the length exactly
+  source->length = end;
+}
+
+/**
+ * @brief Appends a line indented by a number of tabs.
+ *
+ * @param source StringBuilder* where to write the line.
+ * @param tabs int the indentation.
+ * @param line const char* the line, without its newline.
+ */
+static void appendLine(StringBuilder* source, int tabs, const char* line) {
+  for (int i = 0; i < tabs; i++)
+    builderAppend(source, "\t", 1);
+  builderAppendString(source, line);
+  builderAppend(source, "\n", 1);
+}
+
+/**
+ * @brief Generates a document of roughly the given size in a given shape.
+ * Each block of the body is a chain of containers holding a heading and a
+ * paragraph, or a call to one of the document's macros.
+ *
+ * @param source StringBuilder* where to write the document.
+ * @param shape const CorpusShape* the shape of the document.
+ * @param size size_t the size to reach, in bytes.
+ */
+static void generateCorpus(StringBuilder* source, const CorpusShape* shape,
+                           size_t size) {
+  char line[128];
+  for (int i = 0; i < MACRO_COUNT; i++) {
+    snprintf(line, sizeof(line), "@macro%d", i);
+    appendLine(source, 0, line);
+    appendLine(source, 1, "container(\"margin: 4px\")");
+    for (int tab = 0; tab < 2; tab++)
+      builderAppend(source, "\t", 1);
+    builderAppendString(source, "p \"");
+    appendText(source, shape->textLength, i);
+    builderAppendString(source, "\"\n");
+  }
+
+  appendLine(source, 0, "document");
+  appendLine(source, 1, "head");
+  appendLine(source, 2, "title \"Synthetic corpus\"");
+  appendLine(source, 1, "body");
+
+  for (unsigned block = 0; source->length < size; block++) {
+    if ((block * 37) % 100 < (unsigned)shape->macroPercent) {
+      snprintf(line, sizeof(line), "!macro%u", block % MACRO_COUNT);
+      appendLine(source, 2, line);
+      continue;
+    }
+
+    for (int i = 0; i < shape->depth; i++) {
+      snprintf(line, sizeof(line), "container(\"padding: %dpx\")", i % 16);
+      appendLine(source, 2 + i, line);
+    }
+    snprintf(line, sizeof(line), "h2 \"Block %u\"", block);
+    appendLine(source, 2 + shape->depth, line);
+    for (int tab = 0; tab < 2 + shape->depth; tab++)
+      builderAppend(source, "\t", 1);
+    builderAppendString(source, "p \"");
+    appendText(source, shape->textLength, block);
+    builderAppendString(source, "\"\n");
+  }
+}
+
+/**
+ * @brief Starts measuring a phase's peak memory. Linux resets the peak
+ * resident set size when "5" is written to clear_refs, elsewhere the peak is
+ * the process's so far.
+ *
+ * @return bool true if the peak was reset.
+ */
+static bool resetPeakRss() {
+  FILE* file = fopen("/proc/self/clear_refs", "w");
+  if (file == NULL)
+    return false;
+  bool ok = fputs("5", file) >= 0;
+  return fclose(file) == 0 && ok;
+}
+
+/**
+ * @brief Reads the peak resident set size since it was last reset.
+ *
+ * @return long the peak in KiB, -1 if it can't be read.
+ */
+static long peakRss() {
+  FILE* file = fopen("/proc/self/status", "r");
+  if (file == NULL)
+    return -1;
+  char line[256];
+  long kib = -1;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0) {
+      kib = atol(line + 6);
+      break;
+    }
+  }
+  fclose(file);
+  return kib;
+}
+
+/**
+ * @brief Counts the bytes written to a sink without keeping them.
+ */
+static bool discard(void* userData, const char* chars, size_t length) {
+  (void)chars;
+  *(size_t*)userData += length;
+  return true;
+}
+
+/**
+ * @brief Reads a document the way the command line does, touching every page
+ * so a mapped file is really in memory before the scanner sees it.
+ *
+ * @param path const char* the document.
+ * @param source Source* set to the document.
+ * @return bool false if it could not be read.
+ */
+static bool readCorpus(const char* path, Source* source) {
+  if (!openSource(source, path))
+    return false;
+  volatile char sum = 0;
+  for (size_t i = 0; i < source->length; i += 4096)
+    sum += source->chars[i];
+  (void)sum;
+  return true;
+}
+
+/**
+ * @brief Tokenizes a whole document.
+ *
+ * @param chars const char* the document.
+ * @param length size_t its length.
+ * @return int the number of tokens, -1 if it could not be tokenized.
+ */
+static int scanCorpus(const char* chars, size_t length) {
+  Arena arena;
+  initArena(&arena);
+  Scanner scanner;
+  initScanner(&scanner, chars, length, &arena);
+  TokenBuffer tokens;
+  initTokenBuffer(&tokens);
+
+  int count = tokenize(&tokens, &scanner) ? tokens.count : -1;
+
+  freeTokenBuffer(&tokens);
+  freeScanner(&scanner);
+  freeArena(&arena);
+  return count;
+}
+
+/**
+ * @brief Writes compiled HTML to a file through a file sink.
+ *
+ * @param html const char* the HTML.
+ * @param length size_t its length.
+ * @return bool false if the file could not be written.
+ */
+static bool writeCorpus(const char* html, size_t length) {
+  Sink output;
+  if (!openFileSink(&output, OUTPUT_PATH))
+    return false;
+  sinkWrite(&output, html, length);
+  return closeSink(&output);
+}
+
+/**
+ * @brief Benchmarks every phase on one document, keeping the fastest round of
+ * each.
+ *
+ * @param path const char* the document's file.
+ * @param rounds int how many times to run each phase.
+ * @param context ChtmlContext* the context to compile with.
+ * @param results PhaseResult* set to each phase's result.
+ * @param tokens int* set to the number of tokens in the document.
+ * @param htmlLength size_t* set to the length of the compiled document.
+ * @return bool false if the document could not be built.
+ */
+static bool benchCorpus(const char* path, int rounds, ChtmlContext* context,
+                        PhaseResult* results, int* tokens,
+                        size_t* htmlLength) {
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    results[phase].millis = INFINITY;
+    results[phase].peakKib = 0;
+  }
+
+  Source source;
+  if (!readCorpus(path, &source))
+    return false;
+  if (!chtmlCompileString(context, source.chars, source.length)) {
+    fprintf(stderr, "Compile error in '%s': %s\n", path, chtmlError(context));
+    closeSource(&source);
+    return false;
+  }
+  const char* html = chtmlResult(context, htmlLength);
+
+  bool ok = true;
+  for (int round = 0; round < rounds && ok; round++) {
+    for (int phase = 0; phase < PHASE_COUNT && ok; phase++) {
+      resetPeakRss();
+      double start = clockMillis();
+      switch (phase) {
+        case PHASE_READ: {
+          Source again;
+          ok = readCorpus(path, &again);
+          if (ok)
+            closeSource(&again);
+          break;
+        }
+        case PHASE_SCAN:
+          *tokens = scanCorpus(source.chars, source.length);
+          ok = *tokens >= 0;
+          break;
+        case PHASE_COMPILE: {
+          size_t written = 0;
+          Sink output;
+          initCallbackSink(&output, discard, &written);
+          ok = chtmlCompile(context, source.chars, source.length, &output);
+          break;
+        }
+        case PHASE_WRITE:
+          ok = writeCorpus(html, *htmlLength);
+          break;
+      }
+      double millis = clockMillis() - start;
+      long kib = peakRss();
+
+      if (millis < results[phase].millis)
+        results[phase].millis = millis;
+      if (kib > results[phase].peakKib)
+        results[phase].peakKib = kib;
+    }
+  }
+
+  closeSource(&source);
+  remove(OUTPUT_PATH);
+  return ok;
+}
+
+/**
+ * @brief Prints the usage of the benchmark.
+ *
+ * @param name the name the program was run as.
+ */
+static void usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [--max-size KiB] [--rounds n] [--json results.jsonl]\n",
+          name);
+}
+
+int main(int argc, const char* argv[]) {
+  size_t maxSize = DEFAULT_MAX_SIZE;
+  int rounds = DEFAULT_ROUNDS;
+  const char* jsonPath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+      maxSize = (size_t)atol(argv[++i]) * 1024;
+    } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+      rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      jsonPath = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (maxSize < MIN_SIZE || rounds < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // one JSON object per line, one line per phase of each document
+  FILE* json = NULL;
+  if (jsonPath != NULL && (json = fopen(jsonPath, "w")) == NULL) {
+    fprintf(stderr, "Could not open '%s'\n", jsonPath);
+    return 74;
+  }
+
+  mkdir("build", 0755);
+  mkdir(CORPUS_DIR, 0755);
+  bool peakReset = resetPeakRss();
+  if (!peakReset)
+    printf("Peak RSS can't be reset here, it is the process's so far\n");
+
+  int superlinear = 0;
+  int shapeCount = sizeof(shapes) / sizeof(shapes[0]);
+  for (int s = 0; s < shapeCount; s++) {
+    const CorpusShape* shape = &shapes[s];
+    printf("\n%s: depth %d, %d%% macro calls, %d character paragraphs\n",
+           shape->name, shape->depth, shape->macroPercent, shape->textLength);
+    printf("%10s %-8s %10s %10s %12s %10s %7s\n", "KiB", "phase", "ms", "MB/s",
+           "tokens/s", "peak KiB", "x2");
+
+    double previous[PHASE_COUNT];
+    for (size_t size = MIN_SIZE; size <= maxSize; size *= 2) {
+      StringBuilder source;
+      initBuilder(&source);
+      generateCorpus(&source, shape, size);
+      char path[256];
+      snprintf(path, sizeof(path), "%s/%s-%zu.ch", CORPUS_DIR, shape->name,
+               size / 1024);
+      FILE* file = fopen(path, "wb");
+      bool written = file != NULL &&
+                     fwrite(source.chars, 1, source.length, file) ==
+                         source.length;
+      if (file != NULL && fclose(file) != 0)
+        written = false;
+      size_t sourceLength = source.length;
+      freeBuilder(&source);
+      if (!written) {
+        fprintf(stderr, "Could not write '%s'\n", path);
+        return 74;
+      }
+
+      // a fresh context, so no document inherits the last one's buffers
+      ChtmlContext* context = chtmlCreate();
+      PhaseResult results[PHASE_COUNT];
+      int tokens = 0;
+      size_t htmlLength = 0;
+      bool ok = benchCorpus(path, rounds, context, results, &tokens,
+                            &htmlLength);
+      chtmlDestroy(context);
+      if (!ok) {
+        fprintf(stderr, "Could not benchmark '%s'\n", path);
+        return 1;
+      }
+
+      for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        double millis = results[phase].millis;
+        // writing is measured against the html, everything else the source
+        size_t bytes = phase == PHASE_WRITE ? htmlLength : sourceLength;
+        double mbPerSecond = bytes / (millis * 1000.0);
+        bool counted = phase == PHASE_SCAN || phase == PHASE_COMPILE;
+        double tokensPerSecond = counted ? tokens / (millis / 1000.0) : 0;
+        double ratio = size > MIN_SIZE ? millis / previous[phase] : 0;
+        bool flagged = ratio > SUPERLINEAR_RATIO &&
+                       previous[phase] >= SUPERLINEAR_MIN_MILLIS;
+        previous[phase] = millis;
+        superlinear += flagged;
+        printf("%10zu %-8s %10.3f %10.1f %12.0f %10ld ", sourceLength / 1024,
+               phaseNames[phase], millis, mbPerSecond, tokensPerSecond,
+               results[phase].peakKib);
+        if (ratio > 0)
+          printf("%7.2f%s\n", ratio, flagged ? " !" : "");
+        else
+          printf("%7s\n", "-");
+
+        if (json == NULL)
+          continue;
+        fprintf(json,
+                "{\"shape\": \"%s\", \"depth\": %d, \"macro_percent\": %d, "
+                "\"text_length\": %d, \"source_bytes\": %zu, "
+                "\"html_bytes\": %zu, \"tokens\": %d, \"phase\": \"%s\", "
+                "\"ms\": %.4f, \"mb_per_s\": %.2f, ",
+                shape->name, shape->depth, shape->macroPercent,
+                shape->textLength, sourceLength, htmlLength, tokens,
+                phaseNames[phase], millis, mbPerSecond);
+        if (counted)
+          fprintf(json, "\"tokens_per_s\": %.0f, ", tokensPerSecond);
+        else
+          fprintf(json, "\"tokens_per_s\": null, ");
+        fprintf(json, "\"peak_rss_kib\": %ld, \"peak_rss_reset\": %s, ",
+                results[phase].peakKib, peakReset ? "true" : "false");
+        if (ratio > 0)
+          fprintf(json, "\"doubling_ratio\": %.3f}\n", ratio);
+        else
+          fprintf(json, "\"doubling_ratio\": null}\n");
+      }
+    }
+  }
+
+  printf("\nx2 is the time against the same phase at half the size, about 2 "
+         "is linear\n");
+  if (superlinear > 0)
+    printf("%d phase(s) grew more than %.1fx when their input doubled (!)\n",
+           superlinear, SUPERLINEAR_RATIO);
+
+  if (json != NULL && fclose(json) != 0) {
+    fprintf(stderr, "Could not write '%s'\n", jsonPath);
+    return 74;
+  }
+  return 0;
+}
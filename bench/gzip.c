@@ -0,0 +1,162 @@
+/**
+ * @file gzip.c
+ * @author Devin Arena
+ * @brief Benchmark comparing writing a page and its gzipped copy in one
+ * streaming pass against compiling the page and gzipping the file after, the
+ * way the CDN origin was fed before.
+ * @since 12/3/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "../src/builder.h"
+#include "../src/chtml.h"
+#include "../src/gzip.h"
+#include "../src/source.h"
+#include "../src/timer.h"
+
+#define ROUNDS 20
+#define OUTPUT_PATH "build/bench-gzip.html"
+#define GZIP_PATH "build/bench-gzip.html.gz"
+
+/**
+ * @brief Builds a page of cards, roughly what the service renders.
+ *
+ * @param source StringBuilder* where to write the document.
+ * @param cards int how many cards the page has.
+ */
+static void generatePage(StringBuilder* source, int cards) {
+  builderAppendString(source,
+                      "@note\n"
+                      "\tp \"Generated for the gzip benchmark.\"\n"
+                      "document\n"
+                      "\thead\n"
+                      "\t\ttitle \"Gzip benchmark\"\n"
+                      "\t\tcss \"./test.css\"\n"
+                      "\tbody\n");
+  for (int i = 0; i < cards; i++) {
+    char card[256];
+    snprintf(card, sizeof(card),
+             "\t\tcontainer(\"padding: %dpx\")\n"
+             "\t\t\th2 \"Card %d\"\n"
+             "\t\t\tp \"Some text describing card %d in a sentence.\"\n"
+             "\t\t\t!note\n",
+             i % 16, i, i);
+    builderAppendString(source, card);
+  }
+}
+
+/**
+ * @brief Gzips a finished file into another, reading it back the way a
+ * separate gzip run would.
+ *
+ * @param inputPath const char* the file to compress.
+ * @param outputPath const char* the .gz file to write.
+ * @param level int the compression level.
+ * @return bool false if either file failed.
+ */
+static bool gzipFile(const char* inputPath, const char* outputPath,
+                     int level) {
+  Source source;
+  if (!openSource(&source, inputPath))
+    return false;
+  FILE* file = fopen(outputPath, "wb");
+  if (file == NULL) {
+    closeSource(&source);
+    return false;
+  }
+
+  GzipWriter writer;
+  initGzipWriter(&writer, file, level);
+  gzipWrite(&writer, source.chars, source.length);
+  closeSource(&source);
+  return closeGzipWriter(&writer);
+}
+
+/**
+ * @brief Prints a timing line.
+ *
+ * @param name the label to print.
+ * @param millis the time all rounds took.
+ * @param bytes the HTML produced per round.
+ */
+static void report(const char* name, double millis, size_t bytes) {
+  printf("%-24s %8.3f ms/page  %8.1f MB/s\n", name, millis / ROUNDS,
+         bytes * (double)ROUNDS / (millis * 1000.0));
+}
+
+int main(int argc, const char* argv[]) {
+  StringBuilder generated;
+  initBuilder(&generated);
+  Source file = {0};
+  const char* source;
+  size_t length;
+
+  // a document given on the command line is benchmarked instead
+  if (argc > 1) {
+    if (!openSource(&file, argv[1])) {
+      fprintf(stderr, "Could not read file '%s'\n", argv[1]);
+      return 74;
+    }
+    source = file.chars;
+    length = file.length;
+  } else {
+    generatePage(&generated, 50000);
+    source = generated.chars;
+    length = generated.length;
+  }
+
+  ChtmlContext* context = chtmlCreate();
+  if (!chtmlCompileString(context, source, length)) {
+    fprintf(stderr, "Compile error: %s\n", chtmlError(context));
+    return 1;
+  }
+  size_t htmlLength;
+  chtmlResult(context, &htmlLength);
+
+  static const int levels[] = {1, GZIP_DEFAULT_LEVEL, 9};
+  for (int i = 0; i < 3; i++) {
+    int level = levels[i];
+    char name[64];
+
+    chtmlSetGzip(context, 0);
+    double start = clockMillis();
+    for (int round = 0; round < ROUNDS; round++) {
+      if (!chtmlCompileToFile(context, source, length, OUTPUT_PATH) ||
+          !gzipFile(OUTPUT_PATH, GZIP_PATH, level)) {
+        fprintf(stderr, "Could not write '%s'\n", GZIP_PATH);
+        return 1;
+      }
+    }
+    snprintf(name, sizeof(name), "compile then gzip -%d", level);
+    report(name, clockMillis() - start, htmlLength);
+
+    chtmlSetGzip(context, level);
+    double compressing = 0;
+    start = clockMillis();
+    for (int round = 0; round < ROUNDS; round++) {
+      if (!chtmlCompileToFile(context, source, length, OUTPUT_PATH)) {
+        fprintf(stderr, "Compile error: %s\n", chtmlError(context));
+        return 1;
+      }
+      compressing += chtmlGzipMillis(context);
+    }
+    snprintf(name, sizeof(name), "one pass gzip -%d", level);
+    report(name, clockMillis() - start, htmlLength);
+    printf("%-24s %8.3f ms/page\n", "  of which compressing",
+           compressing / ROUNDS);
+  }
+
+  printf("%zu bytes of source, %zu bytes of html\n", length, htmlLength);
+
+  freeBuilder(&generated);
+  if (argc > 1)
+    closeSource(&file);
+  chtmlDestroy(context);
+  remove(OUTPUT_PATH);
+  remove(GZIP_PATH);
+  return 0;
+}
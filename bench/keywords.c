@@ -0,0 +1,152 @@
+/**
+ * @file keywords.c
+ * @author Devin Arena
+ * @brief Microbenchmark comparing the generated keyword table against the
+ * allocate-and-strcmp classifier scanToken used before it.
+ * @since 11/26/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/keyword.h"
+#include "../src/timer.h"
+
+#define ROUNDS 200000
+
+static const char* identifiers[] = {
+    "document", "head",  "data",  "body",     "content", "title", "con",
+    "container", "div",  "h1",    "h2",       "h3",      "h4",    "h5",
+    "h6",        "p",    "css",   "redbox",   "pi",      "card",  "header",
+    "footer",    "hero", "nav",   "sidebar",  "c",       "cons",  "dx",
+};
+
+#define IDENTIFIER_COUNT (int)(sizeof(identifiers) / sizeof(identifiers[0]))
+
+/**
+ * @brief The classifier scanToken used before keywords.def, kept verbatim
+ * apart from taking a span instead of the scanner.
+ */
+static TokenType legacyType(const char* start, size_t length) {
+  length++;
+  if (length == 2 && *start == 'p')
+    return TOKEN_PARAGRAPH;
+
+  char* token = malloc(length * sizeof(char*));
+  memcpy(token, start, length - 1);
+  token[length - 1] = '\0';
+
+  TokenType output = TOKEN_IDENTIFIER;
+  switch (token[0]) {
+    case 'b':
+      if (strcmp(token, "body") == 0)
+        output = TOKEN_BODY;
+      break;
+    case 'c':
+      if (length > 1) {
+        switch (token[1]) {
+          case 'o':
+            if (length > 2 && token[2] == 'n' && length > 3) {
+              if (length == 4)
+                output = TOKEN_CONTAINER;
+              else if (token[3] == 't' && length > 4) {
+                if (token[4] == 'a' && strcmp(token, "container") == 0)
+                  output = TOKEN_CONTAINER;
+                else if (token[4] == 'e' && strcmp(token, "content") == 0)
+                  output = TOKEN_BODY;
+              }
+            }
+            break;
+          case 's':
+            if (strcmp(token, "css") == 0)
+              output = TOKEN_CSS;
+            break;
+        }
+      }
+      break;
+    case 'd':
+      if (length > 1) {
+        switch (token[1]) {
+          case 'o':
+            if (strcmp(token, "document") == 0)
+              output = TOKEN_DOCUMENT;
+            break;
+          case 'i':
+            if (strcmp(token, "div") == 0)
+              output = TOKEN_CONTAINER;
+            break;
+          case 'a':
+            if (strcmp(token, "data") == 0)
+              output = TOKEN_HEAD;
+            break;
+        }
+      }
+      break;
+    case 'h':
+      if (length > 1) {
+        if (token[1] >= '1' && token[1] <= '6')
+          output = TOKEN_HEADING1 + (token[1] - '1');
+        else if (token[1] == 'e' && strcmp(token, "head") == 0)
+          output = TOKEN_HEAD;
+      }
+      break;
+    case 't':
+      if (strcmp(token, "title") == 0)
+        output = TOKEN_TITLE;
+      break;
+  }
+
+  free(token);
+  return output;
+}
+
+/**
+ * @brief Times one classifier over every identifier ROUNDS times.
+ *
+ * @param name the label to print.
+ * @param classify the classifier to time.
+ * @return long the checksum of the results, so the work is not elided.
+ */
+static long run(const char* name,
+                TokenType (*classify)(const char*, size_t)) {
+  size_t lengths[IDENTIFIER_COUNT];
+  for (int i = 0; i < IDENTIFIER_COUNT; i++)
+    lengths[i] = strlen(identifiers[i]);
+
+  long checksum = 0;
+  double start = clockMillis();
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int i = 0; i < IDENTIFIER_COUNT; i++)
+      checksum += classify(identifiers[i], lengths[i]);
+  }
+  double millis = clockMillis() - start;
+
+  double count = (double)ROUNDS * IDENTIFIER_COUNT;
+  printf("%-8s %8.2f M identifiers/s  %6.2f ns/identifier\n", name,
+         count / millis / 1000.0, millis * 1e6 / count);
+  return checksum;
+}
+
+/**
+ * @brief Adapts keywordType to the benchmark's classifier signature.
+ */
+static TokenType tableType(const char* start, size_t length) {
+  return keywordType(start, (int)length);
+}
+
+int main() {
+  // both classifiers must agree before their speed means anything
+  for (int i = 0; i < IDENTIFIER_COUNT; i++) {
+    size_t length = strlen(identifiers[i]);
+    if (legacyType(identifiers[i], length) !=
+        tableType(identifiers[i], length)) {
+      fprintf(stderr, "Classifiers disagree on '%s'\n", identifiers[i]);
+      return 1;
+    }
+  }
+
+  long before = run("before", legacyType);
+  long after = run("after", tableType);
+  return before == after ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file table.c
+ * @author Devin Arena
+ * @brief Microbenchmark for the interning hash table under insert, lookup
+ * and delete heavy workloads.
+ * @since 12/1/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/table.h"
+#include "../src/timer.h"
+
+// a macro table's worth of keys fits in cache, the large run does not
+#define SMALL_KEY_COUNT 1000
+#define LARGE_KEY_COUNT 100000
+// every workload performs about this many operations per size
+#define OPERATIONS 2000000
+
+/**
+ * @brief Fills in macro-like names of varying length.
+ *
+ * @param keys char** where to store the keys.
+ * @param lengths int* where to store their lengths.
+ * @param count int how many keys to generate.
+ */
+static void generateKeys(char** keys, int* lengths, int count) {
+  static const char* words[] = {"box", "card", "header", "navigation",
+                                "x", "footer_links_column", "hero", "p"};
+  for (int i = 0; i < count; i++) {
+    char key[64];
+    lengths[i] = snprintf(key, sizeof(key), "%s%d", words[i % 8], i);
+    keys[i] = strdup(key);
+  }
+}
+
+/**
+ * @brief Prints a timing line.
+ *
+ * @param name the label to print.
+ * @param count how many keys the table held.
+ * @param operations how many table operations were timed.
+ * @param millis how long they took.
+ */
+static void report(const char* name, int count, double operations,
+                   double millis) {
+  printf("%-8s %6d keys %8.2f M ops/s  %6.2f ns/op\n", name, count,
+         operations / millis / 1000.0, millis * 1e6 / operations);
+}
+
+/**
+ * @brief Times inserting, looking up and churning a number of keys.
+ *
+ * @param count int how many keys the table holds.
+ * @return bool false if the table lost track of a key.
+ */
+static bool run(int count) {
+  char** keys = malloc(sizeof(char*) * count);
+  int* lengths = malloc(sizeof(int) * count);
+  generateKeys(keys, lengths, count);
+  int rounds = OPERATIONS / count;
+
+  Table table;
+  double millis = 0;
+  for (int round = 0; round < rounds; round++) {
+    initTable(&table);
+    double start = clockMillis();
+    for (int i = 0; i < count; i++)
+      tableSet(&table, keys[i], keys[i]);
+    millis += clockMillis() - start;
+    if (round < rounds - 1)
+      freeTable(&table);
+  }
+  report("insert", count, (double)count * rounds, millis);
+
+  // spans, the way the compiler looks up macro calls
+  long found = 0;
+  double start = clockMillis();
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < count; i++)
+      found += tableGetString(&table, keys[i], lengths[i]) == keys[i];
+  }
+  report("lookup", count, (double)count * rounds, clockMillis() - start);
+
+  // delete and reinsert half the keys, then check every key is still found
+  start = clockMillis();
+  for (int round = 0; round < rounds; round++) {
+    for (int i = round % 2; i < count; i += 2)
+      tableDelete(&table, keys[i]);
+    for (int i = round % 2; i < count; i += 2)
+      tableSet(&table, keys[i], keys[i]);
+  }
+  report("churn", count, (double)count * rounds, clockMillis() - start);
+
+  for (int i = 0; i < count; i++)
+    found += tableGet(&table, keys[i]) == keys[i];
+
+  bool ok = found == (long)count * (rounds + 1) && table.count == count;
+
+  freeTable(&table);
+  for (int i = 0; i < count; i++)
+    free(keys[i]);
+  free(keys);
+  free(lengths);
+  return ok;
+}
+
+int main() {
+  bool ok = run(SMALL_KEY_COUNT) && run(LARGE_KEY_COUNT);
+  if (!ok)
+    fprintf(stderr, "Table lost keys\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file templates.c
+ * @author Devin Arena
+ * @brief Benchmark comparing compiling a document from source against
+ * rendering its precompiled template.
+ * @since 11/30/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/builder.h"
+#include "../src/chtml.h"
+#include "../src/source.h"
+#include "../src/timer.h"
+
+#define ROUNDS 200
+#define TEMPLATE_PATH "build/bench-templates.chc"
+
+/**
+ * @brief Builds a page of cards sharing a couple of macros, roughly what the
+ * service renders.
+ *
+ * @param source StringBuilder* where to write the document.
+ * @param cards int how many cards the page has.
+ */
+static void generatePage(StringBuilder* source, int cards) {
+  builderAppendString(source,
+                      "@note\n"
+                      "\tp \"Generated for the template benchmark.\"\n"
+                      "@footer\n"
+                      "\tcon(\"color: gray\")\n"
+                      "document\n"
+                      "\thead\n"
+                      "\t\ttitle \"Template benchmark\"\n"
+                      "\t\tcss \"./test.css\"\n"
+                      "\tbody\n");
+  for (int i = 0; i < cards; i++) {
+    char card[256];
+    snprintf(card, sizeof(card),
+             "\t\tcontainer(\"padding: %dpx\")\n"
+             "\t\t\th2 \"Card %d\"\n"
+             "\t\t\tp \"Some text describing card %d in a sentence.\"\n"
+             "\t\t\t!note\n"
+             "\t\t\t!footer\n"
+             "\t\t\t\tp \"Card %d footer.\"\n",
+             i % 16, i, i, i);
+    builderAppendString(source, card);
+  }
+}
+
+/**
+ * @brief Writes a sink's output nowhere, the benchmark only times producing
+ * it.
+ */
+static bool discard(void* userData, const char* chars, size_t length) {
+  (void)chars;
+  *(size_t*)userData += length;
+  return true;
+}
+
+/**
+ * @brief Prints a timing line.
+ *
+ * @param name the label to print.
+ * @param millis the time all rounds took.
+ * @param bytes the HTML produced per round.
+ */
+static void report(const char* name, double millis, size_t bytes) {
+  printf("%-16s %8.3f ms/page  %8.1f MB/s\n", name, millis / ROUNDS,
+         bytes * (double)ROUNDS / (millis * 1000.0));
+}
+
+int main(int argc, const char* argv[]) {
+  StringBuilder generated;
+  initBuilder(&generated);
+  Source file = {0};
+  const char* source;
+  size_t length;
+
+  // a document given on the command line is benchmarked instead
+  if (argc > 1) {
+    if (!openSource(&file, argv[1])) {
+      fprintf(stderr, "Could not read file '%s'\n", argv[1]);
+      return 74;
+    }
+    source = file.chars;
+    length = file.length;
+  } else {
+    generatePage(&generated, 2000);
+    source = generated.chars;
+    length = generated.length;
+  }
+
+  ChtmlContext* context = chtmlCreate();
+  Sink output;
+  if (!openFileSink(&output, TEMPLATE_PATH) ||
+      !chtmlCompileTemplate(context, source, length, &output) ||
+      !closeSink(&output)) {
+    fprintf(stderr, "Could not write template: %s\n",
+            chtmlError(context) ? chtmlError(context) : TEMPLATE_PATH);
+    return 1;
+  }
+
+  // both paths must produce the same page before their speed means anything
+  if (!chtmlCompileString(context, source, length)) {
+    fprintf(stderr, "Compile error: %s\n", chtmlError(context));
+    return 1;
+  }
+  size_t htmlLength;
+  char* html = strdup(chtmlResult(context, &htmlLength));
+
+  StringBuilder rendered;
+  initBuilder(&rendered);
+  initMemorySink(&output, &rendered);
+  if (!chtmlRenderTemplateFile(context, TEMPLATE_PATH, &output) ||
+      rendered.length != htmlLength ||
+      memcmp(rendered.chars, html, htmlLength) != 0) {
+    fprintf(stderr, "Template renders a different page\n");
+    return 1;
+  }
+
+  size_t written = 0;
+  double start = clockMillis();
+  for (int round = 0; round < ROUNDS; round++) {
+    initCallbackSink(&output, discard, &written);
+    chtmlCompile(context, source, length, &output);
+  }
+  report("compile", clockMillis() - start, htmlLength);
+
+  start = clockMillis();
+  for (int round = 0; round < ROUNDS; round++) {
+    initCallbackSink(&output, discard, &written);
+    chtmlRenderTemplateFile(context, TEMPLATE_PATH, &output);
+  }
+  report("render template", clockMillis() - start, htmlLength);
+
+  printf("%zu bytes of source, %zu bytes of html\n", length, htmlLength);
+
+  free(html);
+  freeBuilder(&rendered);
+  freeBuilder(&generated);
+  if (argc > 1)
+    closeSource(&file);
+  chtmlDestroy(context);
+  remove(TEMPLATE_PATH);
+  return 0;
+}
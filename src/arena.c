@@ -0,0 +1,110 @@
+/**
+ * @file arena.c
+ * @author Devin Arena
+ * @brief A bump pointer arena. Allocating is a pointer increment and
+ * everything allocated is released together, in time proportional to the
+ * number of blocks rather than the number of allocations.
+ * @since 11/29/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/**
+ * @brief Initializes an empty arena, no memory is allocated until the first
+ * allocation.
+ *
+ * @param arena Arena* the arena to initialize.
+ */
+void initArena(Arena* arena) {
+  arena->blocks = NULL;
+  arena->blockSize = ARENA_BLOCK_SIZE;
+}
+
+/**
+ * @brief Frees every block of the arena.
+ *
+ * @param arena Arena* the arena to free.
+ */
+void freeArena(Arena* arena) {
+  ArenaBlock* block = arena->blocks;
+  while (block != NULL) {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks = NULL;
+}
+
+/**
+ * @brief Releases everything allocated from the arena but keeps its newest
+ * (largest) block, so an arena reused for similar work stops allocating.
+ *
+ * @param arena Arena* the arena to reset.
+ */
+void resetArena(Arena* arena) {
+  ArenaBlock* newest = arena->blocks;
+  if (newest == NULL)
+    return;
+
+  ArenaBlock* block = newest->next;
+  while (block != NULL) {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  newest->next = NULL;
+  newest->used = 0;
+}
+
+/**
+ * @brief Allocates memory from the arena, aligned to ARENA_ALIGNMENT. The
+ * memory lives until the arena is reset or freed.
+ *
+ * @param arena Arena* the arena to allocate from.
+ * @param size size_t the number of bytes to allocate.
+ * @return void* the allocated memory.
+ */
+void* arenaAlloc(Arena* arena, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+  ArenaBlock* block = arena->blocks;
+  if (block == NULL || block->size - block->used < size) {
+    size_t blockSize = block == NULL ? arena->blockSize : block->size * 2;
+    if (blockSize > ARENA_MAX_BLOCK_SIZE)
+      blockSize = ARENA_MAX_BLOCK_SIZE;
+    if (blockSize < size)
+      blockSize = size;
+
+    ArenaBlock* grown = malloc(sizeof(ArenaBlock) + blockSize);
+    if (grown == NULL) {
+      fprintf(stderr, "Not enough memory to grow arena\n");
+      exit(74);
+    }
+    grown->next = block;
+    grown->size = blockSize;
+    grown->used = 0;
+    arena->blocks = block = grown;
+  }
+
+  void* memory = block->data + block->used;
+  block->used += size;
+  return memory;
+}
+
+/**
+ * @brief Copies characters into the arena.
+ *
+ * @param arena Arena* the arena to copy into.
+ * @param chars const char* the characters to copy.
+ * @param length size_t the number of characters.
+ * @return char* the copy, not NUL terminated.
+ */
+char* arenaCopy(Arena* arena, const char* chars, size_t length) {
+  char* copy = arenaAlloc(arena, length);
+  memcpy(copy, chars, length);
+  return copy;
+}
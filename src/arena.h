@@ -0,0 +1,40 @@
+/**
+ * @file arena.h
+ * @author Devin Arena
+ * @brief Header for the bump pointer arena.
+ * @since 11/29/2022
+ **/
+
+#ifndef CHTML_ARENA_H
+#define CHTML_ARENA_H
+
+#include <stddef.h>
+
+// the first block's size by default, later blocks double up to the maximum
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_MAX_BLOCK_SIZE (16 * 1024 * 1024)
+// nothing allocated from an arena needs more than pointer alignment
+#define ARENA_ALIGNMENT 8
+
+typedef struct ArenaBlock {
+  struct ArenaBlock* next;
+  size_t size;
+  size_t used;
+  _Alignas(ARENA_ALIGNMENT) char data[];
+} ArenaBlock;
+
+// allocations are never freed one by one, only all at once
+typedef struct {
+  // newest block first
+  ArenaBlock* blocks;
+  // the size of the first block, arenas holding little can start smaller
+  size_t blockSize;
+} Arena;
+
+void initArena(Arena* arena);
+void freeArena(Arena* arena);
+void resetArena(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size);
+char* arenaCopy(Arena* arena, const char* chars, size_t length);
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file builder.c
+ * @author Devin Arena
+ * @brief Implementation of the string builder used to collect compiler output.
+ * @since 11/12/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builder.h"
+
+// capacity grows geometrically so appends are amortized O(1)
+#define GROW_CAPACITY(capacity) ((capacity) < 64 ? 64 : (capacity) * 2)
+
+/**
+ * @brief Initializes a builder by zeroing out all of its memory.
+ *
+ * @param builder StringBuilder* the builder to initialize.
+ */
+void initBuilder(StringBuilder* builder) {
+  builder->chars = NULL;
+  builder->length = 0;
+  builder->capacity = 0;
+  builder->growths = 0;
+}
+
+/**
+ * @brief Frees a builder's character buffer and zeroes its memory.
+ *
+ * @param builder StringBuilder* the builder to free.
+ */
+void freeBuilder(StringBuilder* builder) {
+  free(builder->chars);
+  initBuilder(builder);
+}
+
+/**
+ * @brief Grows the builder so length more characters (and the terminator)
+ * fit without another allocation.
+ *
+ * @param builder StringBuilder* the builder to grow.
+ * @param length size_t the number of characters about to be appended.
+ */
+void builderReserve(StringBuilder* builder, size_t length) {
+  size_t needed = builder->length + length + 1;
+  if (needed <= builder->capacity)
+    return;
+
+  // repeated small reservations still grow geometrically
+  size_t capacity = GROW_CAPACITY(builder->capacity);
+  if (capacity < needed)
+    capacity = needed;
+
+  char* grown = realloc(builder->chars, capacity);
+  if (grown == NULL) {
+    fprintf(stderr, "Not enough memory to grow output buffer\n");
+    exit(74);
+  }
+  builder->chars = grown;
+  builder->growths++;
+  builder->capacity = capacity;
+}
+
+/**
+ * @brief Appends length characters to the builder, growing the buffer if
+ * needed. The buffer is always kept NUL terminated.
+ *
+ * @param builder StringBuilder* the builder to append to.
+ * @param chars const char* the characters to append.
+ * @param length size_t the number of characters to append.
+ */
+void builderAppend(StringBuilder* builder, const char* chars, size_t length) {
+  // + 1 leaves room for the terminator
+  if (builder->length + length + 1 > builder->capacity) {
+    size_t capacity = GROW_CAPACITY(builder->capacity);
+    while (capacity < builder->length + length + 1)
+      capacity *= 2;
+
+    char* grown = realloc(builder->chars, capacity);
+    if (grown == NULL) {
+      fprintf(stderr, "Not enough memory to grow output buffer\n");
+      exit(74);
+    }
+    builder->chars = grown;
+    builder->capacity = capacity;
+  }
+
+  memcpy(builder->chars + builder->length, chars, length);
+  builder->length += length;
+  builder->chars[builder->length] = '\0';
+}
+
+/**
+ * @brief Appends a NUL terminated string to the builder.
+ *
+ * @param builder StringBuilder* the builder to append to.
+ * @param str const char* the string to append.
+ */
+void builderAppendString(StringBuilder* builder, const char* str) {
+  builderAppend(builder, str, strlen(str));
+}
@@ -0,0 +1,27 @@
+/**
+ * @file builder.h
+ * @author Devin Arena
+ * @brief Header for a growable, length-aware string builder.
+ * @since 11/12/2022
+ **/
+
+#ifndef CHTML_BUILDER_H
+#define CHTML_BUILDER_H
+
+#include <stddef.h>
+
+typedef struct {
+  char* chars;
+  size_t length;
+  size_t capacity;
+  // times the buffer was reallocated, for stats
+  size_t growths;
+} StringBuilder;
+
+void initBuilder(StringBuilder* builder);
+void freeBuilder(StringBuilder* builder);
+void builderReserve(StringBuilder* builder, size_t length);
+void builderAppend(StringBuilder* builder, const char* chars, size_t length);
+void builderAppendString(StringBuilder* builder, const char* str);
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file cache.c
+ * @author Devin Arena
+ * @brief A content addressed build cache. Compiled pages are stored under a
+ * key made from the source bytes, the compiler version and the contents of
+ * every external file the compile referenced, so unchanged pages are linked
+ * into place without scanning or compiling.
+ *
+ * Two kinds of file live in the cache directory:
+ *   <source hash>.deps  the resolved dependency paths of that source, one per
+ *                       line, needed to work out the full key
+ *   <key>.html          the compiled page for a full key
+ *   <key>.html.gz       its gzipped copy, for builds writing them
+ * @since 11/22/2022
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "builder.h"
+#include "cache.h"
+#include "hash.h"
+#include "path.h"
+#include "source.h"
+
+/**
+ * @brief Opens (creating if needed) a cache directory.
+ *
+ * @param cache Cache* the cache to initialize.
+ * @param dir const char* the directory to keep entries in.
+ * @return bool false if the directory could not be created.
+ */
+bool openCache(Cache* cache, const char* dir) {
+  if (!makeDirectories(dir))
+    return false;
+  cache->dir = strdup(dir);
+  return true;
+}
+
+/**
+ * @brief Frees a cache's memory, entries stay on disk.
+ *
+ * @param cache Cache* the cache to close.
+ */
+void closeCache(Cache* cache) {
+  free(cache->dir);
+  cache->dir = NULL;
+}
+
+/**
+ * @brief Builds the path of a cache entry.
+ *
+ * @param cache Cache* the cache.
+ * @param hash uint64_t the entry's hash.
+ * @param extension const char* the entry's extension.
+ * @return char* the path, must be freed.
+ */
+static char* entryPath(Cache* cache, uint64_t hash, const char* extension) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx%s", (unsigned long long)hash,
+           extension);
+  return joinPath(cache->dir, name);
+}
+
+/**
+ * @brief Mixes a dependency's path and current contents into a key. Missing
+ * files hash differently from every existing file, so creating one later
+ * changes the key.
+ *
+ * @param hash uint64_t the key so far.
+ * @param path const char* the dependency's path.
+ * @return uint64_t the updated key.
+ */
+static uint64_t hashDependency(uint64_t hash, const char* path) {
+  hash = hash64(hash, path, strlen(path) + 1);
+
+  Source source;
+  if (!openSource(&source, path))
+    return hash64(hash, "\xff missing", 9);
+
+  hash = hash64(hash, &source.length, sizeof(source.length));
+  hash = hash64(hash, source.chars, source.length);
+  closeSource(&source);
+  return hash;
+}
+
+/**
+ * @brief Reads the dependency list stored for a source and computes its key.
+ *
+ * @param cache Cache* the cache.
+ * @param sourceHash uint64_t the hash of the source and compiler version.
+ * @param key uint64_t* set to the full key.
+ * @return bool false if the source has never been compiled into the cache.
+ */
+static bool lookupKey(Cache* cache, uint64_t sourceHash, uint64_t* key) {
+  char* path = entryPath(cache, sourceHash, ".deps");
+  Source deps;
+  bool found = openSource(&deps, path);
+  free(path);
+  if (!found)
+    return false;
+
+  uint64_t hash = sourceHash;
+  const char* line = deps.chars;
+  const char* end = deps.chars + deps.length;
+  while (line < end) {
+    const char* newline = memchr(line, '\n', end - line);
+    if (newline == NULL)
+      newline = end;
+
+    char* dependency = strndup(line, newline - line);
+    hash = hashDependency(hash, dependency);
+    free(dependency);
+    line = newline + 1;
+  }
+  closeSource(&deps);
+
+  *key = hash;
+  return true;
+}
+
+/**
+ * @brief Compiles a file through the cache. If the source, compiler version
+ * and every dependency match a previous compile, the cached page is linked
+ * to the output and nothing is scanned or compiled. Pages with fingerprinted
+ * stylesheets are always compiled.
+ *
+ * @param cache Cache* the cache to use.
+ * @param context ChtmlContext* the context to compile with on a miss.
+ * @param inputPath const char* the CHTML file to read.
+ * @param outputPath const char* the HTML file to write.
+ * @param hit bool* set to true if the output came from the cache.
+ * @return bool false on error, see chtmlError.
+ */
+bool cacheCompileFile(Cache* cache,
+                      ChtmlContext* context,
+                      const char* inputPath,
+                      const char* outputPath,
+                      bool* hit) {
+  *hit = false;
+
+  // a hit would link the page without placing the stylesheets it links
+  if (chtmlCssMode(context) == CHTML_CSS_FINGERPRINT)
+    return chtmlCompileFile(context, inputPath, outputPath);
+
+  Source source;
+  if (!openSource(&source, inputPath))
+    return chtmlCompileFile(context, inputPath, outputPath);
+
+  uint64_t sourceHash = hash64(HASH64_SEED, CHTML_VERSION,
+                               sizeof(CHTML_VERSION));
+  // inlined pages differ from linked ones built from the same source
+  ChtmlCssMode cssMode = chtmlCssMode(context);
+  if (cssMode != CHTML_CSS_LINK) {
+    sourceHash = hash64(sourceHash, &cssMode, sizeof(cssMode));
+    // stylesheets are read relative to the page, so identical pages in
+    // different directories can inline different ones
+    char* canonical = canonicalPath(inputPath);
+    if (canonical != NULL) {
+      size_t dirLength = strrchr(canonical, '/') - canonical;
+      sourceHash = hash64(sourceHash, canonical, dirLength);
+      free(canonical);
+    } else {
+      sourceHash = hash64(sourceHash, inputPath, strlen(inputPath) + 1);
+    }
+  }
+  sourceHash = hash64(sourceHash, source.chars, source.length);
+
+  // the gzipped copy is cached beside the page
+  bool gzip = chtmlGzipLevel(context) > 0;
+  char* gzipPath = NULL;
+  if (gzip) {
+    size_t pathLength = strlen(outputPath);
+    gzipPath = malloc(pathLength + 4);
+    memcpy(gzipPath, outputPath, pathLength);
+    memcpy(gzipPath + pathLength, ".gz", 4);
+  }
+
+  uint64_t key;
+  if (lookupKey(cache, sourceHash, &key)) {
+    char* object = entryPath(cache, key, ".html");
+    char* gzipObject = gzip ? entryPath(cache, key, ".html.gz") : NULL;
+    *hit = (!gzip || linkOrCopy(gzipObject, gzipPath)) &&
+           linkOrCopy(object, outputPath);
+    free(object);
+    free(gzipObject);
+    if (*hit) {
+      closeSource(&source);
+      free(gzipPath);
+      return true;
+    }
+  }
+
+  // compile from the bytes that were hashed, so the entry can't go stale
+  const char* sourcePath = chtmlSourcePath(context);
+  chtmlSetSourcePath(context, inputPath);
+  bool ok = chtmlCompileToFile(context, source.chars, source.length,
+                               outputPath);
+  chtmlSetSourcePath(context, sourcePath);
+  closeSource(&source);
+  if (!ok) {
+    free(gzipPath);
+    return false;
+  }
+
+  StringBuilder deps;
+  initBuilder(&deps);
+  key = sourceHash;
+  for (int i = 0; i < chtmlDependencyCount(context); i++) {
+    const char* dependency = chtmlDependency(context, i);
+    // urls are not files, the source hash already covers them
+    if (strstr(dependency, "://") != NULL || strncmp(dependency, "//", 2) == 0)
+      continue;
+
+    char* path = resolvePath(inputPath, dependency, strlen(dependency));
+    builderAppendString(&deps, path);
+    builderAppend(&deps, "\n", 1);
+    key = hashDependency(key, path);
+    free(path);
+  }
+
+  // a cache that can't be written only costs a recompile next time
+  char* depsPath = entryPath(cache, sourceHash, ".deps");
+  char* object = entryPath(cache, key, ".html");
+  char* gzipObject = gzip ? entryPath(cache, key, ".html.gz") : NULL;
+  if (writeAtomically(depsPath, deps.chars, deps.length)) {
+    if (gzip)
+      linkOrCopy(gzipPath, gzipObject);
+    linkOrCopy(outputPath, object);
+  }
+  free(depsPath);
+  free(object);
+  free(gzipObject);
+  free(gzipPath);
+  freeBuilder(&deps);
+
+  return true;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file cache.h
+ * @author Devin Arena
+ * @brief Header for the content addressed build cache.
+ * @since 11/22/2022
+ **/
+
+#ifndef CHTML_CACHE_H
+#define CHTML_CACHE_H
+
+#include <stdbool.h>
+
+#include "chtml.h"
+
+typedef struct {
+  char* dir;
+} Cache;
+
+bool openCache(Cache* cache, const char* dir);
+void closeCache(Cache* cache);
+bool cacheCompileFile(Cache* cache,
+                      ChtmlContext* context,
+                      const char* inputPath,
+                      const char* outputPath,
+                      bool* hit);
+
+#endif
@@ -0,0 +1,749 @@
+/**
+ * @file chtml.c
+ * @author Devin Arena
+ * @brief Library entry points wrapping the scanner and compiler in a context
+ * object.
+ * @since 11/16/2022
+ **/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "builder.h"
+#include "chtml.h"
+#include "compiler.h"
+#include "gzip.h"
+#include "path.h"
+#include "source.h"
+#include "stylesheet.h"
+#include "timer.h"
+
+struct ChtmlContext {
+  Compiler compiler;
+  StringBuilder result;
+  const char* error;
+  // files are also written gzipped when this is above 0
+  int gzipLevel;
+  double gzipMillis;
+  // fingerprinted names of the last compile's dependencies, NULL for those
+  // without one, in the compiler's arena (NULL when css isn't fingerprinted)
+  char** fingerprints;
+};
+
+static Table builtins;
+static Arena builtinMacros;
+static pthread_once_t builtinsOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Builds the process wide table of built in macros, run once.
+ */
+static void loadBuiltins() {
+  initArena(&builtinMacros);
+  initBuiltins(&builtins, &builtinMacros);
+}
+
+/**
+ * @brief Allocates a new compile context.
+ *
+ * @return ChtmlContext* the context, or NULL if out of memory.
+ */
+ChtmlContext* chtmlCreate() {
+  ChtmlContext* context = malloc(sizeof(ChtmlContext));
+  if (context == NULL)
+    return NULL;
+
+  initScanner(&context->compiler.scanner, NULL, 0,
+              &context->compiler.arena);
+  initCompiler(&context->compiler);
+  pthread_once(&builtinsOnce, loadBuiltins);
+  context->compiler.builtins = &builtins;
+  initBuilder(&context->result);
+  context->error = NULL;
+  context->gzipLevel = 0;
+  context->gzipMillis = 0;
+  context->fingerprints = NULL;
+  return context;
+}
+
+/**
+ * @brief Frees a context and everything it owns.
+ *
+ * @param context ChtmlContext* the context to free.
+ */
+void chtmlDestroy(ChtmlContext* context) {
+  if (context == NULL)
+    return;
+
+  freeCompiler(&context->compiler);
+  freeBuilder(&context->result);
+  free(context);
+}
+
+/**
+ * @brief Sets how many threads the context compiles large in-memory
+ * documents with. Contexts start out compiling on the calling thread only.
+ *
+ * @param context ChtmlContext* the context to configure.
+ * @param jobs int the number of threads, <= 0 uses one per core.
+ */
+void chtmlSetJobs(ChtmlContext* context, int jobs) {
+  setCompilerJobs(&context->compiler, jobs);
+}
+
+/**
+ * @brief Makes compiles to files also write a gzipped copy beside each file
+ * (index.html.gz beside index.html), compressed as the HTML is written.
+ *
+ * @param context ChtmlContext* the context to configure.
+ * @param level int the compression level 1-9, 0 turns it off.
+ */
+void chtmlSetGzip(ChtmlContext* context, int level) {
+  context->gzipLevel = level < 0 ? 0 : level > 9 ? 9 : level;
+}
+
+/**
+ * @brief Returns the compression level set with chtmlSetGzip.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @return int the level, 0 when off.
+ */
+int chtmlGzipLevel(ChtmlContext* context) {
+  return context->gzipLevel;
+}
+
+/**
+ * @brief Returns how long the last compile to a file spent compressing.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @return double the time in milliseconds, 0 when gzip is off.
+ */
+double chtmlGzipMillis(ChtmlContext* context) {
+  return context->gzipMillis;
+}
+
+/**
+ * @brief Sets whether css tags link or embed their stylesheets. Embedded
+ * stylesheets are read, and fingerprinted ones hashed, once per process and
+ * reused until they change.
+ *
+ * @param context ChtmlContext* the context to configure.
+ * @param mode ChtmlCssMode how to write css tags.
+ */
+void chtmlSetCssMode(ChtmlContext* context, ChtmlCssMode mode) {
+  context->compiler.inlineCss =
+      mode == CHTML_CSS_INLINE || mode == CHTML_CSS_INLINE_MINIFIED;
+  context->compiler.minifyCss = mode == CHTML_CSS_INLINE_MINIFIED;
+  context->compiler.fingerprintCss = mode == CHTML_CSS_FINGERPRINT;
+}
+
+/**
+ * @brief Returns the mode set with chtmlSetCssMode.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @return ChtmlCssMode how css tags are written.
+ */
+ChtmlCssMode chtmlCssMode(ChtmlContext* context) {
+  if (context->compiler.fingerprintCss)
+    return CHTML_CSS_FINGERPRINT;
+  if (!context->compiler.inlineCss)
+    return CHTML_CSS_LINK;
+  return context->compiler.minifyCss ? CHTML_CSS_INLINE_MINIFIED
+                                     : CHTML_CSS_INLINE;
+}
+
+/**
+ * @brief Sets where the context counts what its compiles do: time spent
+ * reading, scanning, compiling and writing, tokens by type, macros, output
+ * and tag depth. Counts add up over every compile until it is changed.
+ *
+ * @param context ChtmlContext* the context to configure.
+ * @param stats Stats* the stats to add to, kept rather than copied, NULL
+ * (the default) turns counting off.
+ */
+void chtmlSetStats(ChtmlContext* context, Stats* stats) {
+  context->compiler.stats = stats;
+}
+
+/**
+ * @brief Sets the file the next compiles' documents came from, stylesheets
+ * they embed are read relative to it. chtmlCompileFile sets it itself.
+ *
+ * @param context ChtmlContext* the context to configure.
+ * @param path const char* the document's path, kept rather than copied,
+ * NULL for the working directory.
+ */
+void chtmlSetSourcePath(ChtmlContext* context, const char* path) {
+  context->compiler.sourcePath = path;
+}
+
+/**
+ * @brief Returns the path set with chtmlSetSourcePath.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @return const char* the document's path, NULL for the working directory.
+ */
+const char* chtmlSourcePath(ChtmlContext* context) {
+  return context->compiler.sourcePath;
+}
+
+/**
+ * @brief Works out the fingerprinted names of the stylesheets the last
+ * compile linked, the same names cssTag wrote into the page.
+ *
+ * @param context ChtmlContext* the context that compiled.
+ */
+static void fingerprintDependencies(ChtmlContext* context) {
+  Compiler* compiler = &context->compiler;
+  if (compiler->dependencyCount == 0)
+    return;
+
+  context->fingerprints = arenaAlloc(
+      &compiler->arena, sizeof(char*) * compiler->dependencyCount);
+  for (int i = 0; i < compiler->dependencyCount; i++) {
+    const char* dependency = compiler->dependencies[i];
+    char* fingerprinted = fingerprintStylesheet(
+        compiler->sourcePath, dependency, strlen(dependency));
+    context->fingerprints[i] = NULL;
+    if (fingerprinted != NULL) {
+      context->fingerprints[i] = arenaCopy(&compiler->arena, fingerprinted,
+                                           strlen(fingerprinted) + 1);
+      free(fingerprinted);
+    }
+  }
+}
+
+/**
+ * @brief Adds the time since start to a phase's timer.
+ *
+ * @param stats Stats* the stats to add to, NULL when off.
+ * @param phase StatsPhase the phase the time was spent in.
+ * @param start double when the phase started.
+ */
+static void addPhaseMillis(Stats* stats, StatsPhase phase, double start) {
+  if (STATS_ON(stats))
+    stats->millis[phase] += clockMillis() - start;
+}
+
+/**
+ * @brief Runs the compiler over whatever the scanner was set up with. With
+ * stats on, the time compile spent that it did not spend scanning or
+ * writing counts as compiling.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param output Sink* where to write the HTML.
+ * @return bool false on error, see chtmlError.
+ */
+static bool run(ChtmlContext* context, Sink* output) {
+  Compiler* compiler = &context->compiler;
+  Stats* stats = compiler->stats;
+
+  double start = 0;
+  double scanning = 0;
+  double writing = 0;
+  size_t written = output->written;
+  size_t growths = 0;
+  if (STATS_ON(stats)) {
+    start = clockMillis();
+    scanning = stats->millis[STATS_SCAN];
+    writing = stats->millis[STATS_WRITE];
+    if (output->type == SINK_MEMORY)
+      growths = output->as.builder->growths;
+  }
+
+  context->fingerprints = NULL;
+  // macros never outlive a single document, compile resets them
+  bool ok = compile(compiler, output);
+  if (ok && !flushSink(output)) {
+    snprintf(compiler->error, sizeof(compiler->error),
+             "Could not write output");
+    ok = false;
+  }
+
+  if (STATS_ON(stats)) {
+    stats->millis[STATS_COMPILE] +=
+        clockMillis() - start - (stats->millis[STATS_SCAN] - scanning) -
+        (stats->millis[STATS_WRITE] - writing);
+    addDefinitions(stats, compiler->scanner.defined,
+                   compiler->scanner.definedCount);
+    stats->bytesEmitted += output->written - written;
+    if (output->type == SINK_MEMORY)
+      stats->outputReallocations += output->as.builder->growths - growths;
+  }
+
+  if (ok && compiler->fingerprintCss)
+    fingerprintDependencies(context);
+
+  freeScanner(&compiler->scanner);
+  context->error = ok ? NULL : compiler->error;
+  return ok;
+}
+
+/**
+ * @brief Compiles a source buffer, streaming the HTML to a sink.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param source const char* the CHTML source, need not be NUL terminated.
+ * @param length size_t the length of the source.
+ * @param output Sink* where to write the HTML.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlCompile(ChtmlContext* context,
+                  const char* source,
+                  size_t length,
+                  Sink* output) {
+  initScanner(&context->compiler.scanner, source, length,
+              &context->compiler.arena);
+  return run(context, output);
+}
+
+/**
+ * @brief Compiles a source read in chunks from a descriptor, streaming the
+ * HTML to a sink.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param fd int the descriptor to read from, not closed.
+ * @param output Sink* where to write the HTML.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlCompileStream(ChtmlContext* context, int fd, Sink* output) {
+  initStreamScanner(&context->compiler.scanner, fd,
+                    &context->compiler.arena);
+  return run(context, output);
+}
+
+/**
+ * @brief Records an error that happened outside of the compiler (reading the
+ * source or writing the output).
+ *
+ * @param context ChtmlContext* the context the error belongs to.
+ * @param format const char* printf style format for the message.
+ * @param path const char* the file involved.
+ */
+static void fileError(ChtmlContext* context, const char* format,
+                      const char* path) {
+  char* error = context->compiler.error;
+  size_t length = snprintf(error, sizeof(context->compiler.error), format,
+                           path);
+  if (length < sizeof(context->compiler.error))
+    snprintf(error + length, sizeof(context->compiler.error) - length, ": %s",
+             strerror(errno));
+  context->error = error;
+}
+
+/**
+ * @brief Opens a temporary file beside a path, to be renamed over it once it
+ * has been written.
+ *
+ * @param context ChtmlContext* the context to report errors to.
+ * @param path const char* the file that will be replaced.
+ * @param tempPath char** set to the temporary file's path, to be freed.
+ * @return FILE* the open file, or NULL on error.
+ */
+static FILE* openTempFile(ChtmlContext* context, const char* path,
+                          char** tempPath) {
+  size_t pathLength = strlen(path);
+  *tempPath = malloc(pathLength + 8);
+  memcpy(*tempPath, path, pathLength);
+  memcpy(*tempPath + pathLength, ".XXXXXX", 8);
+
+  int fd = mkstemp(*tempPath);
+  FILE* file = fd < 0 ? NULL : fdopen(fd, "wb");
+  if (file == NULL) {
+    fileError(context, "Could not open output file '%s'", path);
+    if (fd >= 0) {
+      close(fd);
+      remove(*tempPath);
+    }
+    free(*tempPath);
+    *tempPath = NULL;
+    return NULL;
+  }
+  fchmod(fd, 0644);
+  return file;
+}
+
+/**
+ * @brief Places the fingerprinted copies of the stylesheets the last compile
+ * linked beside the page, at the same path relative to it as the original is
+ * to the source. Copies that already exist are left alone, their names
+ * change with their contents. chtmlCompileToFile calls it itself, compiles
+ * to other sinks call it once they know where the page went.
+ *
+ * @param context ChtmlContext* the context that compiled.
+ * @param outputPath const char* the page being written.
+ * @return bool false if a stylesheet could not be placed, see chtmlError.
+ */
+bool chtmlPlaceStylesheets(ChtmlContext* context, const char* outputPath) {
+  Compiler* compiler = &context->compiler;
+  if (context->fingerprints == NULL)
+    return true;
+
+  bool ok = true;
+  for (int i = 0; i < compiler->dependencyCount && ok; i++) {
+    const char* fingerprinted = context->fingerprints[i];
+    if (fingerprinted == NULL)
+      continue;
+
+    char* asset = resolvePath(outputPath, fingerprinted, strlen(fingerprinted));
+    struct stat info;
+    if (stat(asset, &info) != 0) {
+      const char* dependency = compiler->dependencies[i];
+      char* original = resolvePath(
+          compiler->sourcePath != NULL ? compiler->sourcePath : "",
+          dependency, strlen(dependency));
+
+      char* slash = strrchr(asset, '/');
+      if (slash != NULL) {
+        *slash = '\0';
+        ok = makeDirectories(asset);
+        *slash = '/';
+      }
+      ok = ok && linkOrCopy(original, asset);
+      if (!ok)
+        fileError(context, "Could not write stylesheet '%s'", asset);
+      free(original);
+    }
+    free(asset);
+  }
+  return ok;
+}
+
+/**
+ * @brief Compiles a source buffer into a file. Regular files are written to a
+ * temporary file and renamed into place, so a failed build never leaves a
+ * truncated document behind and files hard linked to the old output (build
+ * cache entries) are never modified. With gzip on, the gzipped copy is
+ * written in the same pass, and fingerprinted stylesheets are placed before
+ * the page that links them.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param source const char* the CHTML source, need not be NUL terminated.
+ * @param length size_t the length of the source.
+ * @param outputPath const char* the HTML file to write.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlCompileToFile(ChtmlContext* context,
+                        const char* source,
+                        size_t length,
+                        const char* outputPath) {
+  context->gzipMillis = 0;
+
+  // devices and pipes are written in place, and have no gzipped twin
+  struct stat info;
+  if (stat(outputPath, &info) == 0 && !S_ISREG(info.st_mode)) {
+    Sink output;
+    if (!openFileSink(&output, outputPath)) {
+      fileError(context, "Could not open output file '%s'", outputPath);
+      return false;
+    }
+    bool ok = chtmlCompile(context, source, length, &output);
+    if (!closeSink(&output) && ok) {
+      fileError(context, "Could not write output '%s'", outputPath);
+      ok = false;
+    }
+    return ok;
+  }
+
+  size_t pathLength = strlen(outputPath);
+  char* gzipPath = NULL;
+  if (context->gzipLevel > 0) {
+    gzipPath = malloc(pathLength + 4);
+    memcpy(gzipPath, outputPath, pathLength);
+    memcpy(gzipPath + pathLength, ".gz", 4);
+  }
+
+  char* tempPath;
+  FILE* file = openTempFile(context, outputPath, &tempPath);
+  if (file == NULL) {
+    free(gzipPath);
+    return false;
+  }
+
+  Sink output;
+  initFileSink(&output, file);
+  output.owned = true;
+
+  GzipWriter gzip;
+  char* gzipTempPath = NULL;
+  if (gzipPath != NULL) {
+    FILE* gzipFile = openTempFile(context, gzipPath, &gzipTempPath);
+    if (gzipFile == NULL) {
+      closeSink(&output);
+      remove(tempPath);
+      free(tempPath);
+      free(gzipPath);
+      return false;
+    }
+    initGzipWriter(&gzip, gzipFile, context->gzipLevel);
+    output.gzip = &gzip;
+  }
+
+  bool ok = chtmlCompile(context, source, length, &output);
+  double start = STATS_ON(context->compiler.stats) ? clockMillis() : 0;
+  if (!closeSink(&output) && ok) {
+    fileError(context, "Could not write output '%s'", outputPath);
+    ok = false;
+  }
+  if (gzipPath != NULL) {
+    if (!closeGzipWriter(&gzip) && ok) {
+      fileError(context, "Could not write output '%s'", gzipPath);
+      ok = false;
+    }
+    context->gzipMillis = gzip.millis;
+    if (STATS_ON(context->compiler.stats))
+      addGzipMillis(context->compiler.stats, gzip.millis);
+  }
+
+  // the page goes in last, so it never links a stylesheet that isn't there
+  // and is never newer than its gzipped copy
+  ok = ok && chtmlPlaceStylesheets(context, outputPath);
+  if (ok && gzipPath != NULL && rename(gzipTempPath, gzipPath) != 0) {
+    fileError(context, "Could not write output '%s'", gzipPath);
+    ok = false;
+  }
+  if (ok && rename(tempPath, outputPath) != 0) {
+    fileError(context, "Could not write output '%s'", outputPath);
+    ok = false;
+  }
+  addPhaseMillis(context->compiler.stats, STATS_WRITE, start);
+
+  if (!ok) {
+    remove(tempPath);
+    if (gzipTempPath != NULL)
+      remove(gzipTempPath);
+  }
+  free(tempPath);
+  free(gzipTempPath);
+  free(gzipPath);
+  return ok;
+}
+
+/**
+ * @brief Compiles one file into another. The source is memory mapped where
+ * possible.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param inputPath const char* the CHTML file to read.
+ * @param outputPath const char* the HTML file to write.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlCompileFile(ChtmlContext* context,
+                      const char* inputPath,
+                      const char* outputPath) {
+  double start = STATS_ON(context->compiler.stats) ? clockMillis() : 0;
+  Source source;
+  if (!openSource(&source, inputPath)) {
+    fileError(context, "Could not read file '%s'", inputPath);
+    return false;
+  }
+  addPhaseMillis(context->compiler.stats, STATS_READ, start);
+
+  const char* sourcePath = context->compiler.sourcePath;
+  context->compiler.sourcePath = inputPath;
+  bool ok = chtmlCompileToFile(context, source.chars, source.length,
+                               outputPath);
+  context->compiler.sourcePath = sourcePath;
+  closeSource(&source);
+  return ok;
+}
+
+/**
+ * @brief Compiles a source buffer into memory owned by the context, retrieve
+ * it with chtmlResult.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param source const char* the CHTML source, need not be NUL terminated.
+ * @param length size_t the length of the source.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlCompileString(ChtmlContext* context,
+                        const char* source,
+                        size_t length) {
+  context->result.length = 0;
+
+  Sink output;
+  initMemorySink(&output, &context->result);
+  return chtmlCompile(context, source, length, &output);
+}
+
+/**
+ * @brief Compiles a source buffer into a precompiled template, which
+ * chtmlRenderTemplate renders without parsing the source again.
+ *
+ * @param context ChtmlContext* the context to compile with.
+ * @param source const char* the CHTML source, need not be NUL terminated.
+ * @param length size_t the length of the source.
+ * @param output Sink* where to write the template.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlCompileTemplate(ChtmlContext* context,
+                          const char* source,
+                          size_t length,
+                          Sink* output) {
+  Compiler* compiler = &context->compiler;
+  TemplateWriter writer;
+  initTemplateWriter(&writer);
+
+  compiler->template = &writer;
+  bool ok = chtmlCompile(context, source, length, output);
+  compiler->template = NULL;
+
+  if (ok) {
+    for (int i = 0; i < compiler->dependencyCount; i++)
+      writeTemplateDependency(&writer, compiler->dependencies[i]);
+    // the compile only filled in the writer, this writes the template
+    double start = STATS_ON(compiler->stats) ? clockMillis() : 0;
+    size_t written = output->written;
+    finishTemplate(&writer, output);
+
+    if (!flushSink(output)) {
+      snprintf(compiler->error, sizeof(compiler->error),
+               "Could not write output");
+      context->error = compiler->error;
+      ok = false;
+    }
+    addPhaseMillis(compiler->stats, STATS_WRITE, start);
+    if (STATS_ON(compiler->stats))
+      compiler->stats->bytesEmitted += output->written - written;
+  }
+
+  freeTemplateWriter(&writer);
+  return ok;
+}
+
+/**
+ * @brief Renders a precompiled template to a sink. The template is
+ * validated first, nothing is written if it is damaged. Its dependencies
+ * are reported like those of a compile.
+ *
+ * @param context ChtmlContext* the context to render with.
+ * @param chars const char* the template, 8 byte aligned.
+ * @param length size_t the length of the template.
+ * @param output Sink* where to write the HTML.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlRenderTemplate(ChtmlContext* context,
+                         const char* chars,
+                         size_t length,
+                         Sink* output) {
+  Compiler* compiler = &context->compiler;
+  resetCompilerArena(compiler);
+  context->fingerprints = NULL;
+
+  Template template;
+  const char* error = loadTemplate(&template, chars, length);
+  if (error != NULL) {
+    snprintf(compiler->error, sizeof(compiler->error), "%s", error);
+    context->error = compiler->error;
+    return false;
+  }
+
+  double start = STATS_ON(compiler->stats) ? clockMillis() : 0;
+  size_t written = output->written;
+  renderTemplate(&template, output);
+  for (uint32_t i = 0; i < template.header->recordCount; i++) {
+    const TemplateRecord* record = &template.records[i];
+    if (record->type == RECORD_DEPENDENCY)
+      addDependency(compiler, template.data + record->offset, record->length);
+  }
+
+  bool ok = flushSink(output);
+  // rendering is all writing, there is nothing to scan or compile
+  addPhaseMillis(compiler->stats, STATS_WRITE, start);
+  if (STATS_ON(compiler->stats))
+    compiler->stats->bytesEmitted += output->written - written;
+  if (!ok)
+    snprintf(compiler->error, sizeof(compiler->error),
+             "Could not write output");
+  context->error = ok ? NULL : compiler->error;
+  return ok;
+}
+
+/**
+ * @brief Renders a precompiled template file to a sink. The file is memory
+ * mapped where possible.
+ *
+ * @param context ChtmlContext* the context to render with.
+ * @param inputPath const char* the template file to read.
+ * @param output Sink* where to write the HTML.
+ * @return bool false on error, see chtmlError.
+ */
+bool chtmlRenderTemplateFile(ChtmlContext* context,
+                             const char* inputPath,
+                             Sink* output) {
+  double start = STATS_ON(context->compiler.stats) ? clockMillis() : 0;
+  Source source;
+  if (!openSource(&source, inputPath)) {
+    fileError(context, "Could not read file '%s'", inputPath);
+    return false;
+  }
+  addPhaseMillis(context->compiler.stats, STATS_READ, start);
+
+  bool ok = chtmlRenderTemplate(context, source.chars, source.length, output);
+  closeSource(&source);
+  return ok;
+}
+
+/**
+ * @brief Returns the HTML from the last chtmlCompileString call. Valid until
+ * the next compile or until the context is destroyed.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @param length size_t* set to the length of the result, may be NULL.
+ * @return const char* the NUL terminated HTML.
+ */
+const char* chtmlResult(ChtmlContext* context, size_t* length) {
+  if (length != NULL)
+    *length = context->result.length;
+  return context->result.chars != NULL ? context->result.chars : "";
+}
+
+/**
+ * @brief Returns the message for the last failed compile.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @return const char* the error, or NULL if the last compile succeeded.
+ */
+const char* chtmlError(ChtmlContext* context) {
+  return context->error;
+}
+
+/**
+ * @brief Returns how many external files the last compile referenced.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @return int the number of dependencies.
+ */
+int chtmlDependencyCount(ChtmlContext* context) {
+  return context->compiler.dependencyCount;
+}
+
+/**
+ * @brief Returns an external file the last compile referenced, as written in
+ * the source (relative paths are relative to the source file).
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @param index int the dependency to return, below chtmlDependencyCount.
+ * @return const char* the path.
+ */
+const char* chtmlDependency(ChtmlContext* context, int index) {
+  return context->compiler.dependencies[index];
+}
+
+/**
+ * @brief Returns the fingerprinted name a stylesheet of the last compile was
+ * linked as, relative to the page as the original is to the source.
+ *
+ * @param context ChtmlContext* the context to read from.
+ * @param index int the dependency, below chtmlDependencyCount.
+ * @return const char* the fingerprinted path, or NULL if css isn't
+ * fingerprinted or the stylesheet couldn't be read.
+ */
+const char* chtmlDependencyFingerprint(ChtmlContext* context, int index) {
+  return context->fingerprints != NULL ? context->fingerprints[index] : NULL;
+}
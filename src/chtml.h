@@ -0,0 +1,78 @@
+/**
+ * @file chtml.h
+ * @author Devin Arena
+ * @brief Public interface of libchtml. Each context owns all of the state for
+ * a compile, so separate contexts can be used from separate threads.
+ * @since 11/16/2022
+ **/
+
+#ifndef CHTML_CHTML_H
+#define CHTML_CHTML_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sink.h"
+#include "stats.h"
+
+#define CHTML_VERSION "1.1"
+
+typedef struct ChtmlContext ChtmlContext;
+
+typedef enum {
+  // css tags link their stylesheet
+  CHTML_CSS_LINK,
+  // css tags embed their stylesheet in a style block
+  CHTML_CSS_INLINE,
+  // as CHTML_CSS_INLINE, with comments and needless whitespace stripped
+  CHTML_CSS_INLINE_MINIFIED,
+  // css tags link a copy of their stylesheet named after its content hash,
+  // placed beside pages compiled to files
+  CHTML_CSS_FINGERPRINT,
+} ChtmlCssMode;
+
+ChtmlContext* chtmlCreate();
+void chtmlDestroy(ChtmlContext* context);
+void chtmlSetJobs(ChtmlContext* context, int jobs);
+void chtmlSetGzip(ChtmlContext* context, int level);
+int chtmlGzipLevel(ChtmlContext* context);
+double chtmlGzipMillis(ChtmlContext* context);
+void chtmlSetCssMode(ChtmlContext* context, ChtmlCssMode mode);
+ChtmlCssMode chtmlCssMode(ChtmlContext* context);
+void chtmlSetSourcePath(ChtmlContext* context, const char* path);
+const char* chtmlSourcePath(ChtmlContext* context);
+void chtmlSetStats(ChtmlContext* context, Stats* stats);
+bool chtmlCompile(ChtmlContext* context,
+                  const char* source,
+                  size_t length,
+                  Sink* output);
+bool chtmlCompileStream(ChtmlContext* context, int fd, Sink* output);
+bool chtmlCompileToFile(ChtmlContext* context,
+                        const char* source,
+                        size_t length,
+                        const char* outputPath);
+bool chtmlCompileFile(ChtmlContext* context,
+                      const char* inputPath,
+                      const char* outputPath);
+bool chtmlPlaceStylesheets(ChtmlContext* context, const char* outputPath);
+bool chtmlCompileString(ChtmlContext* context,
+                        const char* source,
+                        size_t length);
+bool chtmlCompileTemplate(ChtmlContext* context,
+                          const char* source,
+                          size_t length,
+                          Sink* output);
+bool chtmlRenderTemplate(ChtmlContext* context,
+                         const char* chars,
+                         size_t length,
+                         Sink* output);
+bool chtmlRenderTemplateFile(ChtmlContext* context,
+                             const char* inputPath,
+                             Sink* output);
+const char* chtmlResult(ChtmlContext* context, size_t* length);
+const char* chtmlError(ChtmlContext* context);
+int chtmlDependencyCount(ChtmlContext* context);
+const char* chtmlDependency(ChtmlContext* context, int index);
+const char* chtmlDependencyFingerprint(ChtmlContext* context, int index);
+
+#endif
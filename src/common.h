@@ -0,0 +1,15 @@
+/**
+ * @file common.h
+ * @author Devin Arena
+ * @brief Build-wide configuration flags.
+ * @since 11/13/2022
+ **/
+
+#ifndef CHTML_COMMON_H
+#define CHTML_COMMON_H
+
+// Traces every scanned token to stdout. Enabled by `make debug`, left off by
+// default so stdout can carry the compiled document.
+// #define DEBUG_PRINT_TOKENS
+
+#endif
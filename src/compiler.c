@@ -1,11 +1,17 @@
 
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "common.h"
 #include "compiler.h"
+#include "emitter.h"
+#include "path.h"
 #include "scanner.h"
+#include "stylesheet.h"
+#include "timer.h"
 
 /**
  * @file compiler.c
@@ -14,58 +20,133 @@
  * @since 10/30/2022
  **/
 
-Compiler compiler;
+// nodes built up before they are emitted, unless the whole IR is retained
+#define IR_FLUSH_NODES 4096
+// documents with fewer tokens are never split across threads
+#define PARALLEL_MIN_TOKENS 16384
+// segments per thread, several each keeps uneven segments from idling any
+#define SEGMENTS_PER_JOB 4
+// segments below this many tokens are not worth a task
+#define MIN_SEGMENT_TOKENS 256
+// the deepest indentation considered as a place to split the document
+#define MAX_SPLIT_DEPTH 16
+// a depth qualifies for splitting if all but 1/SPLIT_COVERAGE of the nested
+// tokens are at least that deep
+#define SPLIT_COVERAGE 8
 
-static void statement();
-static void expression();
+// a run of whole lines at the split depth, handed to a pool worker as soon
+// as the serial pass reaches it, while the rest of the document is compiled
+// on the calling thread
+typedef struct Segment {
+  Compiler* parent;
+  Compiler* workers;
+  // buffer tokens [first, last), and the TOKEN_MACROs before each end
+  int first;
+  int last;
+  int macrosBefore;
+  int macrosAfter;
+  // recorded when the serial pass reaches the segment, mark is the node the
+  // segment's nodes follow
+  Table macros;
+  int definedMacros;
+  int depth;
+  Node* mark;
+  int dependencyOffset;
+  // the worker's results
+  IR ir;
+  char** dependencies;
+  int dependencyCount;
+  bool ok;
+} Segment;
+
+static void statement(Compiler* compiler);
+static void expression(Compiler* compiler);
+static void skipSegment(Compiler* compiler);
+static void compileSegment(void* arg, int worker);
+static void emitOutput(Compiler* compiler);
 
 /**
- * @brief Writes a string to a file. Called once the compiler has finished
- * generating HTML.
+ * @brief Appends a node to the compiler's IR.
  *
- * @param file the file to write to.
+ * @param type the node's type.
+ * @param chars the node's characters, referenced rather than copied.
+ * @param length the number of characters.
+ * @return Node* the new node.
  */
-static void writeOutput(const char* file) {
-  FILE* f = fopen(file, "w");
-  if (f == NULL) {
-    printf("Error opening file!\n");
-    exit(1);
-  }
-
-  int outputSize = strlen(compiler.output);
-  compiler.output = (char*)realloc(compiler.output, outputSize + 1);
-  compiler.output[outputSize] = '\0';
+static Node* addOutput(Compiler* compiler,
+                       NodeType type,
+                       const char* chars,
+                       size_t length) {
+  // nodes are final once added, so any prefix of the IR can be emitted
+  if (compiler->ir.count >= IR_FLUSH_NODES && !compiler->retainIR)
+    emitOutput(compiler);
+  return addNode(&compiler->ir, type, chars, length);
+}
 
-  fprintf(f, "%s", compiler.output);
-  fclose(f);
+/**
+ * @brief Appends a node holding the contents of a quoted token (without its
+ * quotes).
+ *
+ * @param type the node's type.
+ * @param token the quoted token, its length excludes the closing quote.
+ * @return Node* the new node.
+ */
+static Node* addQuoted(Compiler* compiler, NodeType type, Token token) {
+  return addOutput(compiler, type, token.start + 1, token.length - 1);
 }
 
 /**
- * @brief Adds output to the compiler's output buffer. Contains the HTML
- * generated by the compiler.
+ * @brief Appends a start or end tag.
  *
- * @param str the string to add to the output buffer.
+ * @param type NODE_OPEN or NODE_CLOSE.
+ * @param tag the element.
+ * @return Node* the new node.
+ */
+static Node* addTag(Compiler* compiler, NodeType type, Tag tag) {
+  Node* node = addOutput(compiler, type, NULL, 0);
+  node->tag = tag;
+  return node;
+}
+
+/**
+ * @brief Writes the IR built so far to the output (or the template being
+ * compiled) and drops it. Streams do this before every token, so their
+ * output keeps pace with their input and nodes never outlive the buffers
+ * their characters point into.
  */
-static void addOutput(char* str) {
-  int len = strlen(str);
-  if (!compiler.output) {
-    compiler.output = malloc(len * sizeof(char*));
-    strcpy(compiler.output, str);
+static void emitOutput(Compiler* compiler) {
+  double start = STATS_ON(compiler->stats) ? clockMillis() : 0;
+  if (compiler->template != NULL) {
+    writeTemplateNodes(compiler->template, compiler->ir.first);
   } else {
-    int oldLen = strlen(compiler.output);
-    compiler.output = realloc(compiler.output, (oldLen + len) * sizeof(char*));
-    strcat(compiler.output, str);
+    mergeText(&compiler->ir);
+    emitNodes(compiler->ir.first, compiler->output);
   }
+  resetIR(&compiler->ir);
+  if (STATS_ON(compiler->stats))
+    compiler->stats->millis[STATS_WRITE] += clockMillis() - start;
+}
+
+/**
+ * @brief Pushes what the sink has buffered to its destination.
+ */
+static void flushOutput(Compiler* compiler) {
+  double start = STATS_ON(compiler->stats) ? clockMillis() : 0;
+  flushSink(compiler->output);
+  if (STATS_ON(compiler->stats))
+    compiler->stats->millis[STATS_WRITE] += clockMillis() - start;
 }
 
 /**
- * @brief Displays a compilation error before terminating the program.
+ * @brief Records a compilation error and unwinds back to compile(), which
+ * reports the failure to its caller.
  *
- * @param message the error message to display.
+ * @param message the error message to record.
  */
-static void compileError(char* message) {
-  printf("Compile error: %s", message);
-  exit(1);
+static void compileError(Compiler* compiler, const char* message) {
+  snprintf(compiler->error, sizeof(compiler->error), "%s (line %d)", message,
+           compiler->current.line);
+  longjmp(compiler->errorJump, 1);
 }
 
 /**
@@ -73,8 +154,13 @@ static void compileError(char* message) {
  *
  * @param token the token to push onto the stack.
  */
-static void pushStack(Token token) {
-  *(compiler.stackTop++) = token;
+static void pushStack(Compiler* compiler, Token token) {
+  if (compiler->stackTop - compiler->stack == MAX_DEPTH)
+    compileError(compiler, "Tags nested too deeply");
+  *(compiler->stackTop++) = token;
+  if (STATS_ON(compiler->stats) &&
+      compiler->stackTop - compiler->stack > compiler->stats->maxDepth)
+    compiler->stats->maxDepth = compiler->stackTop - compiler->stack;
 }
 
 /**
@@ -82,8 +168,8 @@ static void pushStack(Token token) {
  *
  * @return Token the token that was popped off the stack.
  */
-static Token popStack() {
-  return *(--compiler.stackTop);
+static Token popStack(Compiler* compiler) {
+  return *(--compiler->stackTop);
 }
 
 /**
@@ -92,17 +178,72 @@ static Token popStack() {
  * @param depth the depth of the token to return.
  * @return Token the token at a depth of 'depth'.
  */
-static Token peekStack(int depth) {
-  return *(compiler.stackTop - depth - 1);
+static Token peekStack(Compiler* compiler, int depth) {
+  return *(compiler->stackTop - depth - 1);
+}
+
+/**
+ * @brief Adds the scanner's definitions up to count to the macro table.
+ *
+ * @param count how many of the scanner's definitions should be visible.
+ */
+static void defineMacros(Compiler* compiler, int count) {
+  for (; compiler->definedMacros < count; compiler->definedMacros++) {
+    Macro* macro = compiler->scanner.defined[compiler->definedMacros];
+    tableSet(&compiler->macros, macro->name, macro);
+  }
+}
+
+/**
+ * @brief Fetches the next token from an open macro expansion, the token
+ * buffer or the scanner. Definitions become visible when their TOKEN_MACRO
+ * is fetched.
+ *
+ * @return Token the next token.
+ */
+static Token nextToken(Compiler* compiler) {
+  Scanner* scanner = &compiler->scanner;
+
+  Token token;
+  compiler->currentIndex = -1;
+  if (!compiler->buffered) {
+    if (compiler->ir.first != NULL)
+      emitOutput(compiler);
+    const char* scanned = scanner->current;
+    token = scanToken(scanner);
+    // macro replays leave the scanner where it was, definitions are
+    // counted once the compile is done
+    if (STATS_ON(compiler->stats) && token.type != TOKEN_MACRO &&
+        (scanner->current != scanned || token.type == TOKEN_EOF))
+      compiler->stats->tokens[token.type]++;
+    if (token.type == TOKEN_MACRO)
+      defineMacros(compiler, scanner->definedCount);
+    return token;
+  }
+
+  if (expansionToken(scanner, &token))
+    return token;
+
+  // the buffer's last token is its EOF
+  int index = compiler->nextToken < compiler->tokenEnd
+                  ? compiler->nextToken++
+                  : compiler->tokens.count - 1;
+  token = tokenAt(&compiler->tokens, index);
+  compiler->currentIndex = index;
+  if (token.type == TOKEN_MACRO) {
+    defineMacros(compiler,
+                 compiler->tokens.definitions[compiler->nextDefinition++]);
+  }
+  return token;
 }
 
 /**
  * @brief Advances the compiler to the next token (assigning the previous
  * token).
  */
-static void advance() {
-  compiler.previous = compiler.current;
-  compiler.current = scanToken();
+static void advance(Compiler* compiler) {
+  compiler->previous = compiler->current;
+  compiler->current = nextToken(compiler);
 }
 
 /**
@@ -111,13 +252,13 @@ static void advance() {
  * @param type the type of token to check for.
  * @param message the error message to display if the token is not found.
  */
-static void consume(TokenType type, char* message) {
-  if (compiler.current.type == type) {
-    advance();
+static void consume(Compiler* compiler, TokenType type, const char* message) {
+  if (compiler->current.type == type) {
+    advance(compiler);
     return;
   }
 
-  compileError(message);
+  compileError(compiler, message);
 }
 
 /**
@@ -126,49 +267,34 @@ static void consume(TokenType type, char* message) {
  * @param type the type of token to check for.
  * @return bool if the current token is of type 'type'.
  */
-static bool match(TokenType type) {
-  if (compiler.current.type == type) {
-    advance();
+static bool match(Compiler* compiler, TokenType type) {
+  if (compiler->current.type == type) {
+    advance(compiler);
     return true;
   }
   return false;
 }
 
-/**
- * @brief Removes quotes from a string. Used to remove quotes from attribute
- * values. ALLOCATES A NEW STRING THAT MUST BE FREED.
- *
- * @param str the string to remove quotes from.
- * @param len the length of the string.
- * @return char* the string with quotes removed. Must be freed.
- */
-static char* removeQuotes(char* str, int len) {
-  char* newStr = malloc((len - 1) * sizeof(char*));
-  strncpy(newStr, str + 1, len - 1);
-  newStr[len - 1] = '\0';
-  return newStr;
-}
-
 /**
  * @brief Generate closing tags for any open tags still on the stack.
  *
  * @param tabs the indentation level of which to stop generating closing tags.
  */
-static void finishTags(int tabs) {
-  while (compiler.stackTop - compiler.stack > 0 && peekStack(0).tab >= tabs) {
-    Token token = popStack();
+static void finishTags(Compiler* compiler, int tabs) {
+  while (compiler->stackTop - compiler->stack > 0 && peekStack(compiler, 0).tab >= tabs) {
+    Token token = popStack(compiler);
     switch (token.type) {
       case TOKEN_DOCUMENT:
-        addOutput("</html>");
+        addTag(compiler, NODE_CLOSE, TAG_HTML);
         break;
       case TOKEN_CONTAINER:
-        addOutput("</div>");
+        addTag(compiler, NODE_CLOSE, TAG_DIV);
         break;
       case TOKEN_HEAD:
-        addOutput("</head>");
+        addTag(compiler, NODE_CLOSE, TAG_HEAD);
         break;
       case TOKEN_BODY:
-        addOutput("</body>");
+        addTag(compiler, NODE_CLOSE, TAG_BODY);
         break;
     }
   }
@@ -176,12 +302,12 @@ static void finishTags(int tabs) {
 
 /**
  * @brief Assigns a macro with the given name.
- * 
+ *
  * @param name the name of the macro.
  * @param value the value of the macro.
  */
-void addMacro(char* name, char* value) {
-  tableSet(&compiler.macros, name, value);
+void addMacro(Compiler* compiler, char* name, char* value) {
+  tableSet(&compiler->macros, name, newMacro(&compiler->arena, value));
 }
 
 /**
@@ -189,40 +315,32 @@ void addMacro(char* name, char* value) {
  * output document.
  * 
  */
-static void text() {
-  Token text = compiler.previous;
+static void text(Compiler* compiler) {
+  Token text = compiler->previous;
+#ifdef DEBUG_PRINT_TOKENS
   printf("%*c", 6, ' ');
   printToken(text);
+#endif
   if (text.type != TOKEN_TEXT) {
-    compileError("Expected text after text-tag token");
+    compileError(compiler, "Expected text after text-tag token");
   }
 
-  char* output = removeQuotes(text.start, text.length);
-  addOutput(output);
-  free(output);
+  addQuoted(compiler, NODE_TEXT, text);
 }
 
 /**
  * @brief Descent case for tokens with text content (title tag, paragraph tag,
  * etc.)
  *
- * @param tagName the tag to open and close around the text
+ * @param tag the tag to open and close around the text
  */
-static void textTag(char* tagName) {
-  int len = snprintf(NULL, 0, "<%s>", tagName);
-
-  char* open = malloc(len * sizeof(char*));
-  sprintf(open, "<%s>", tagName);
+static void textTag(Compiler* compiler, Tag tag) {
+  addTag(compiler, NODE_OPEN, tag);
 
-  addOutput(open);
+  advance(compiler);
+  expression(compiler);
 
-  advance();
-  expression();
-
-  char* close = malloc((len + 1) * sizeof(char*));
-  sprintf(close, "</%s>", tagName);
-  addOutput(close);
-  // free(output);
+  addTag(compiler, NODE_CLOSE, tag);
 }
 
 /**
@@ -230,140 +348,228 @@ static void textTag(char* tagName) {
  *
  * @param headingType the type of heading (h1-h6)
  */
-static void heading() {
-  char* heading = malloc(sizeof(char*) * 2);
-  sprintf(heading, "h%d", compiler.previous.type - TOKEN_HEADING1 + 1);
-  textTag(heading);
-  free(heading);
+static void heading(Compiler* compiler) {
+  textTag(compiler, TAG_H1 + (compiler->previous.type - TOKEN_HEADING1));
 }
 
 /**
  * @brief Descent case for container type tags (document, div, head, body)
  */
-static void container() {
-  Token token = compiler.previous;
+static void container(Compiler* compiler) {
+  Token token = compiler->previous;
 
-  char* tagName;
+  Tag tag;
 
   switch (token.type) {
     case TOKEN_DOCUMENT:
-      tagName = "html";
+      tag = TAG_HTML;
       break;
     case TOKEN_CONTAINER:
-      tagName = "div";
+      tag = TAG_DIV;
       break;
     case TOKEN_HEAD:
-      tagName = "head";
+      tag = TAG_HEAD;
       break;
     case TOKEN_BODY:
-      tagName = "body";
+      tag = TAG_BODY;
       break;
     default:
-      compileError("Expected container type.");
+      compileError(compiler, "Expected container type.");
   }
 
   // Sloppy and should probably be fixed, used for css
-  if (match(TOKEN_LEFT_PAREN)) {
-    consume(TOKEN_TEXT, "Expected text of css inside css block specifier.");
-    char* css = removeQuotes(compiler.previous.start, compiler.previous.length);
-    int len = snprintf(NULL, 0, "<%s style=\"%s\">", token.start, css);
-    char* open = malloc(len * sizeof(char*));
-    sprintf(open, "<%s style=\"%s\">", tagName, css);
-    addOutput(open);
-    free(css);
-    free(open);
-    pushStack(token);
-    consume(TOKEN_RIGHT_PAREN, "Unexpected end of css block specifier.");
-    return;
-  } else {
-    int len = snprintf(NULL, 0, "<%s>", tagName);
-    char* open = malloc(len * sizeof(char*));
-    sprintf(open, "<%s>", tagName);
-    addOutput(open);
-    free(open);
-    pushStack(token);
+  if (match(compiler, TOKEN_LEFT_PAREN)) {
+    consume(compiler, TOKEN_TEXT, "Expected text of css inside css block specifier.");
+    addQuoted(compiler, NODE_OPEN, compiler->previous)->tag = tag;
+    pushStack(compiler, token);
+    consume(compiler, TOKEN_RIGHT_PAREN, "Unexpected end of css block specifier.");
     return;
   }
 
-  pushStack(token);
+  addTag(compiler, NODE_OPEN, tag);
+  pushStack(compiler, token);
 }
 
 /**
- * @brief Descent case for css tags, right now just used to link and insert css
- * eventually will add support for custom properties.
+ * @brief Records an external file the document depends on, so build caches
+ * know what to check before reusing output.
+ *
+ * @param compiler the compiler to record it in.
+ * @param chars the path as written in the source.
+ * @param length the length of the path.
  */
-static void cssTag() {
-  if (peek() == '\n') {
-    return;
+void addDependency(Compiler* compiler, const char* chars, int length) {
+  for (int i = 0; i < compiler->dependencyCount; i++) {
+    const char* dependency = compiler->dependencies[i];
+    if (strncmp(dependency, chars, length) == 0 && dependency[length] == '\0')
+      return;
   }
-  advance();
 
-  Token path = compiler.previous;
-  if (path.type != TOKEN_TEXT) {
-    compileError("Expected path after css-tag token");
+  if (compiler->dependencyCount == compiler->dependencyCapacity) {
+    compiler->dependencyCapacity =
+        compiler->dependencyCapacity < 4 ? 4 : compiler->dependencyCapacity * 2;
+    char** dependencies = arenaAlloc(
+        &compiler->arena, sizeof(char*) * compiler->dependencyCapacity);
+    if (compiler->dependencyCount > 0)
+      memcpy(dependencies, compiler->dependencies,
+             sizeof(char*) * compiler->dependencyCount);
+    compiler->dependencies = dependencies;
   }
-  printf("%*c", 6, ' ');
-  printToken(path);
 
-  char* output = removeQuotes(path.start, path.length);
+  char* dependency = arenaAlloc(&compiler->arena, length + 1);
+  memcpy(dependency, chars, length);
+  dependency[length] = '\0';
+  compiler->dependencies[compiler->dependencyCount++] = dependency;
+}
 
-  const char* template = "<link rel=\"stylesheet\" href=\"%s\" />";
+/**
+ * @brief Forgets the recorded dependencies, their memory belongs to the
+ * arena.
+ */
+static void clearDependencies(Compiler* compiler) {
+  compiler->dependencyCount = 0;
+}
 
-  int len = snprintf(NULL, 0, template, output);
+/**
+ * @brief Releases everything the last compile allocated (its definitions,
+ * macro table and dependencies) but keeps the memory for the next one.
+ *
+ * @param compiler the compiler to reset.
+ */
+void resetCompilerArena(Compiler* compiler) {
+  clearTable(&compiler->macros);
+  compiler->definedMacros = 0;
+  compiler->dependencies = NULL;
+  compiler->dependencyCount = 0;
+  compiler->dependencyCapacity = 0;
+  resetArena(&compiler->arena);
+}
 
-  char* open = malloc(len * sizeof(char*));
-  sprintf(open, template, output);
-  addOutput(open);
-  free(output);
-  free(open);
+/**
+ * @brief Fills in a style node with the stylesheet a css tag names, read
+ * from beside the document. Urls are left to the browser.
+ *
+ * @param node the node to fill in.
+ * @param href the path, as written in the source.
+ * @param length the length of the path.
+ * @return bool false if the stylesheet can't be inlined.
+ */
+static bool inlineStylesheet(Compiler* compiler, Node* node, const char* href,
+                             int length) {
+  if (!isLocalStylesheet(href, length))
+    return false;
+
+  char* path = resolvePath(
+      compiler->sourcePath != NULL ? compiler->sourcePath : "", href, length);
+  // copied into the IR's arena, the cache's copy may be replaced
+  const char* css;
+  size_t cssLength;
+  bool ok = loadStylesheet(path, compiler->minifyCss, &compiler->ir.arena,
+                           &css, &cssLength);
+  free(path);
+  if (ok) {
+    node->chars = css;
+    node->length = cssLength;
+  }
+  return ok;
 }
 
 /**
- * @brief Calling macros with !macroName, in-place replaces the macro with its value.
+ * @brief Descent case for css tags, links the stylesheet or, with inlineCss
+ * set, embeds it. With fingerprintCss set the link names the stylesheet's
+ * fingerprinted copy. Stylesheets that can't be read are linked as written.
  */
-static void callMacro() {
+static void cssTag(Compiler* compiler) {
+  // a bare css tag has no path on its line
+  if (compiler->current.type != TOKEN_TEXT ||
+      compiler->current.line != compiler->previous.line) {
+    return;
+  }
+  advance(compiler);
+
+  Token path = compiler->previous;
+  if (path.type != TOKEN_TEXT) {
+    compileError(compiler, "Expected path after css-tag token");
+  }
+#ifdef DEBUG_PRINT_TOKENS
   printf("%*c", 6, ' ');
-  printToken(compiler.previous);  // Print the macro token
-  int tabs = compiler.previous.tab;
+  printToken(path);
+#endif
+
+  if (compiler->inlineCss) {
+    // the node goes in first, adding it may emit and reset the arena
+    Node* node = addOutput(compiler, NODE_STYLE, NULL, 0);
+    if (!inlineStylesheet(compiler, node, path.start + 1, path.length - 1)) {
+      node->type = NODE_LINK;
+      node->chars = path.start + 1;
+      node->length = path.length - 1;
+    }
+  } else if (compiler->fingerprintCss) {
+    Node* node = addQuoted(compiler, NODE_LINK, path);
+    char* fingerprinted = fingerprintStylesheet(
+        compiler->sourcePath, path.start + 1, path.length - 1);
+    if (fingerprinted != NULL) {
+      node->length = strlen(fingerprinted);
+      node->chars = arenaCopy(&compiler->ir.arena, fingerprinted,
+                              node->length);
+      free(fingerprinted);
+    }
+  } else {
+    addQuoted(compiler, NODE_LINK, path);
+  }
+  addDependency(compiler, path.start + 1, path.length - 1);
+}
 
-  Token name = compiler.current;
+/**
+ * @brief Calling macros with !macroName, replays the macro's tokens in place
+ * of the call.
+ */
+static void callMacro(Compiler* compiler) {
+#ifdef DEBUG_PRINT_TOKENS
+  printf("%*c", 6, ' ');
+  printToken(compiler->previous);  // Print the macro token
+#endif
+  Token name = compiler->current;
   if (name.type != TOKEN_IDENTIFIER) {
-    compileError("Expected name after macro token");
+    compileError(compiler, "Expected name after macro token");
   }
+#ifdef DEBUG_PRINT_TOKENS
   printf("%*c", 6, ' ');
   printToken(name);
+#endif
 
-  char* key = malloc((name.length + 1) * sizeof(char*));
-  strncpy(key, name.start, name.length);
-  key[name.length] = '\0';
-
-  char* value = tableGet(&compiler.macros, key);
-  if (value == NULL) {
-    compileError("Undefined macro");
+  Macro* macro = tableGetString(&compiler->macros, name.start, name.length);
+  if (macro == NULL && compiler->builtins != NULL)
+    macro = tableGetString(compiler->builtins, name.start, name.length);
+  if (macro == NULL) {
+    compileError(compiler, "Undefined macro");
   }
-  insertMacro(tabs, value);
-
-  free(key);
+  if (!expandMacro(&compiler->scanner, macro, compiler->previous)) {
+    compileError(compiler, "Macros nested too deeply");
+  }
+  if (STATS_ON(compiler->stats))
+    compiler->stats->macroExpansions++;
+  addOutput(compiler, NODE_MACRO, name.start, name.length);
 
-  compiler.current = scanToken();
+  compiler->current = nextToken(compiler);
 
-  advance();
-  statement();
+  advance(compiler);
+  statement(compiler);
 }
 
 /**
  * @brief Descent for expressions, generally follow other types of tokens.
  */
-static void expression() {
-  switch (compiler.previous.type) {
+static void expression(Compiler* compiler) {
+  switch (compiler->previous.type) {
     case TOKEN_EXCLAMATION:
-      callMacro();
+      callMacro(compiler);
       break;
     case TOKEN_TEXT:
-      text();
+      text(compiler);
       break;
     default:
-      compileError("Expected expression");
+      compileError(compiler, "Expected expression");
       break;
   }
 }
@@ -371,15 +577,15 @@ static void expression() {
 /**
  * @brief Base descent case for statements.
  */
-static void statement() {
-  Token token = compiler.previous;
+static void statement(Compiler* compiler) {
+  Token token = compiler->previous;
 
   switch (token.type) {
     case TOKEN_DOCUMENT:
     case TOKEN_CONTAINER:
     case TOKEN_HEAD:
     case TOKEN_BODY:
-      container();
+      container(compiler);
       break;
     case TOKEN_HEADING1:
     case TOKEN_HEADING2:
@@ -387,67 +593,686 @@ static void statement() {
     case TOKEN_HEADING4:
     case TOKEN_HEADING5:
     case TOKEN_HEADING6:
-      heading();
+      heading(compiler);
       break;
     case TOKEN_TITLE:
-      textTag("title");
+      textTag(compiler, TAG_TITLE);
       break;
     case TOKEN_PARAGRAPH:
-      textTag("p");
+      textTag(compiler, TAG_P);
       break;
     case TOKEN_CSS:
-      cssTag();
+      cssTag(compiler);
       break;
-    case TOKEN_RAW_HTML: {
-      char* output = malloc((token.length - 2) * sizeof(char*));
-      memcpy(output, token.start + 1, token.length - 2);
-      addOutput(output);
-      free(output);
+    case TOKEN_RAW_HTML:
+      addQuoted(compiler, NODE_RAW, token);
       break;
+    case TOKEN_MACRO:
+      break;
+    default:
+      expression(compiler);
+      break;
+  }
+  compiler->instruction++;
+}
+
+/**
+ * @brief Fills a table with the macros every document can use. The table is
+ * only read while compiling, so one copy can be shared by every compiler.
+ *
+ * @param table the table to fill.
+ * @param arena where the macros are allocated, it must outlive the table.
+ */
+void initBuiltins(Table* table, Arena* arena) {
+  initTable(table);
+  tableSet(table, "pi", newMacro(arena, "\"3.14159\""));
+}
+
+/**
+ * @brief Compiles statements until the current token is EOF, handing
+ * segments of the parallel plan (if any) over to the pool as they come up.
+ */
+static void compileTokens(Compiler* compiler) {
+  while (compiler->current.type != TOKEN_EOF) {
+    if (compiler->nextSegment < compiler->segmentCount &&
+        compiler->currentIndex >=
+            compiler->segments[compiler->nextSegment].first) {
+      skipSegment(compiler);
+      continue;
     }
+
+    advance(compiler);
+
+#ifdef DEBUG_PRINT_TOKENS
+    printf("%.4d: ", compiler->instruction);
+    printToken(compiler->previous);
+#endif
+
+    finishTags(compiler, compiler->previous.tab);
+
+    statement(compiler);
+  }
+#ifdef DEBUG_PRINT_TOKENS
+  printf("%.4d: ", compiler->instruction);
+  printToken(compiler->current);
+#endif
+}
+
+/**
+ * @brief Returns how many of the scanner's definitions are visible once the
+ * first macros TOKEN_MACROs of the buffer have been fetched.
+ *
+ * @param macros the number of TOKEN_MACROs fetched.
+ * @return int the number of visible definitions.
+ */
+static int definitionsAfter(Compiler* compiler, int macros) {
+  return macros == 0 ? 0 : compiler->tokens.definitions[macros - 1];
+}
+
+/**
+ * @brief Checks if a buffered token begins a line.
+ *
+ * @param index the token to check.
+ * @return bool true if only whitespace separates it from a newline before.
+ */
+static bool startsLine(const TokenBuffer* tokens, int index) {
+  if (index == 0)
+    return true;
+  // a definition's token runs up to the line after its body
+  if (tokens->types[index - 1] == TOKEN_MACRO)
+    return true;
+
+  // lines are where tokens end, only quoted tokens and definitions can
+  // start on an earlier one
+  if (tokens->lines[index] == tokens->lines[index - 1])
+    return false;
+  switch ((TokenType)tokens->types[index]) {
+    case TOKEN_TEXT:
+    case TOKEN_RAW_HTML:
     case TOKEN_MACRO:
+    case TOKEN_ERROR:
       break;
     default:
-      expression();
+      return true;
+  }
+
+  uint32_t end = tokens->offsets[index - 1] + tokens->lengths[index - 1];
+  uint32_t start = tokens->offsets[index];
+  return start > end &&
+         memchr(tokens->source + end, '\n', start - end) != NULL;
+}
+
+/**
+ * @brief Checks if a statement can begin at a buffered token without the
+ * statement before it reaching across. Operands (text, parentheses, macro
+ * names) and whatever follows a tag that takes one stay with what precedes
+ * them.
+ *
+ * @param index the token to check.
+ * @return bool true if the document can be split before the token.
+ */
+static bool canSplitAt(const TokenBuffer* tokens, int index) {
+  switch ((TokenType)tokens->types[index]) {
+    case TOKEN_TEXT:
+    case TOKEN_LEFT_PAREN:
+    case TOKEN_RIGHT_PAREN:
+    case TOKEN_IDENTIFIER:
+      return false;
+    default:
       break;
   }
-  compiler.instruction++;
+
+  if (index == 0)
+    return true;
+  switch ((TokenType)tokens->types[index - 1]) {
+    case TOKEN_TITLE:
+    case TOKEN_PARAGRAPH:
+    case TOKEN_HEADING1:
+    case TOKEN_HEADING2:
+    case TOKEN_HEADING3:
+    case TOKEN_HEADING4:
+    case TOKEN_HEADING5:
+    case TOKEN_HEADING6:
+    case TOKEN_EXCLAMATION:
+      return false;
+    default:
+      return true;
+  }
+}
+
+/**
+ * @brief Picks the indentation to split the document at: the deepest one
+ * that still holds nearly all of the tokens nested under the document, as
+ * deeper levels offer more places to split.
+ *
+ * @return int the depth, 0 if the document is too flat to split.
+ */
+static int splitDepth(const TokenBuffer* tokens) {
+  // anything deeper than the deepest split is counted together
+  int counts[MAX_SPLIT_DEPTH + 2] = {0};
+  for (int i = 0; i < tokens->count; i++) {
+    uint32_t tab = tokens->tabs[i];
+    counts[tab > MAX_SPLIT_DEPTH ? MAX_SPLIT_DEPTH + 1 : tab]++;
+  }
+
+  // covered[d] is the number of tokens at least d deep
+  int covered[MAX_SPLIT_DEPTH + 2] = {0};
+  covered[MAX_SPLIT_DEPTH + 1] = counts[MAX_SPLIT_DEPTH + 1];
+  for (int depth = MAX_SPLIT_DEPTH; depth >= 1; depth--)
+    covered[depth] = covered[depth + 1] + counts[depth];
+
+  for (int depth = MAX_SPLIT_DEPTH; depth >= 1; depth--) {
+    if (covered[depth] >= covered[1] - covered[1] / SPLIT_COVERAGE)
+      return covered[depth] > 0 ? depth : 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks if a segment can start at a buffered token, a line at the
+ * split depth that no statement before it reaches into.
+ *
+ * @param index the token to check.
+ * @param depth the split depth.
+ * @return bool true if the token can start a segment.
+ */
+static bool startsSegment(const TokenBuffer* tokens, int index, int depth) {
+  return tokens->tabs[index] == depth && startsLine(tokens, index) &&
+         canSplitAt(tokens, index);
+}
+
+/**
+ * @brief Adds a segment to the plan.
+ *
+ * @param segments the plan, grown as needed.
+ * @param count the number of segments in the plan.
+ * @param capacity the plan's capacity.
+ * @param first the segment's first token.
+ * @param last the token after the segment.
+ */
+static void addSegment(Segment** segments,
+                       int* count,
+                       int* capacity,
+                       int first,
+                       int last) {
+  if (*count == *capacity) {
+    *capacity = *capacity < 8 ? 8 : *capacity * 2;
+    *segments = realloc(*segments, sizeof(Segment) * *capacity);
+  }
+  Segment* segment = &(*segments)[(*count)++];
+  segment->first = first;
+  segment->last = last;
+}
+
+/**
+ * @brief Splits the buffered document into segments that compile the same
+ * on their own. Each region of tokens at least as deep as the split depth
+ * is cut at lines of exactly that depth into pieces of about the target
+ * size. Everything else is left to the serial pass, as are regions too small
+ * to be worth a task and region ends a statement might reach past.
+ *
+ * Only the tabs are read for most tokens, lines are only examined around
+ * the places a cut is made.
+ *
+ * @param jobs the number of workers.
+ * @param segments set to the plan, free it when done.
+ * @return int the number of segments, 0 if the document is not worth
+ * splitting.
+ */
+static int planSegments(Compiler* compiler, int jobs, Segment** segments) {
+  const TokenBuffer* tokens = &compiler->tokens;
+  const uint32_t* tabs = tokens->tabs;
+  int end = tokens->count - 1;
+  *segments = NULL;
+
+  int depth = splitDepth(tokens);
+  if (depth == 0)
+    return 0;
+
+  int target = tokens->count / (jobs * SEGMENTS_PER_JOB);
+  if (target < MIN_SEGMENT_TOKENS)
+    target = MIN_SEGMENT_TOKENS;
+
+  int count = 0;
+  int capacity = 0;
+  int i = 0;
+  while (i < end) {
+    while (i < end && tabs[i] < depth)
+      i++;
+    int first = i;
+    while (i < end && tabs[i] >= depth)
+      i++;
+    int last = i;
+
+    while (first < last && !startsSegment(tokens, first, depth))
+      first++;
+    // the statement ending the region might take the next token with it
+    if (last < end && !canSplitAt(tokens, last)) {
+      do {
+        last--;
+      } while (last > first && !startsSegment(tokens, last, depth));
+    }
+    if (last - first < MIN_SEGMENT_TOKENS)
+      continue;
+
+    while (last - first > target + target / 2) {
+      int cut = first + target;
+      while (cut < last && !startsSegment(tokens, cut, depth))
+        cut++;
+      if (cut == last)
+        break;
+      addSegment(segments, &count, &capacity, first, cut);
+      first = cut;
+    }
+    addSegment(segments, &count, &capacity, first, last);
+  }
+
+  if (count < 2) {
+    free(*segments);
+    *segments = NULL;
+    return 0;
+  }
+
+  int macros = 0;
+  i = 0;
+  for (int s = 0; s < count; s++) {
+    Segment* segment = &(*segments)[s];
+    for (; i < segment->first; i++)
+      macros += tokens->types[i] == TOKEN_MACRO;
+    segment->macrosBefore = macros;
+    for (; i < segment->last; i++)
+      macros += tokens->types[i] == TOKEN_MACRO;
+    segment->macrosAfter = macros;
+
+    segment->parent = compiler;
+    segment->workers = NULL;
+    initTable(&segment->macros);
+    initIR(&segment->ir);
+    segment->dependencies = NULL;
+    segment->dependencyCount = 0;
+    segment->ok = false;
+  }
+
+  return count;
+}
+
+/**
+ * @brief Leaves the next segment to the pool: records where its output and
+ * dependencies belong, submits it, then continues past it as if it had been
+ * compiled.
+ */
+static void skipSegment(Compiler* compiler) {
+  Segment* segment = &compiler->segments[compiler->nextSegment++];
+  // a statement ran into the segment, the plan does not hold
+  if (compiler->currentIndex != segment->first)
+    compileError(compiler, "Statement crosses a parallel segment");
+
+  // the segment's first line closes whatever it would have
+  finishTags(compiler, compiler->current.tab);
+  tableAddAll(&compiler->macros, &segment->macros);
+  segment->definedMacros = compiler->definedMacros;
+  segment->depth = compiler->stackTop - compiler->stack;
+  segment->mark = compiler->ir.last;
+  segment->dependencyOffset = compiler->dependencyCount;
+  // the worker only reads what was recorded above and the finished tokens
+  poolSubmit(compiler->pool, compileSegment, segment);
+
+  compiler->nextToken = segment->last;
+  compiler->nextDefinition = segment->macrosAfter;
+  defineMacros(compiler, definitionsAfter(compiler, segment->macrosAfter));
+  compiler->current = nextToken(compiler);
+}
+
+/**
+ * @brief Pool task compiling one segment into its own IR. The worker's
+ * compiler borrows the parent's tokens and definitions, and starts out with
+ * the macros and stack depth the parent had there, so lookups and limits
+ * behave exactly as they would serially.
+ *
+ * @param arg the Segment to compile.
+ * @param worker the index of the pool worker running the task.
+ */
+static void compileSegment(void* arg, int worker) {
+  Segment* segment = arg;
+  Compiler* parent = segment->parent;
+  Compiler* compiler = &segment->workers[worker];
+
+  Token outer = {.type = TOKEN_EOF, .tab = -1};
+  compiler->stackTop = compiler->stack;
+  for (int i = 0; i < segment->depth; i++)
+    *(compiler->stackTop++) = outer;
+
+  clearTable(&compiler->macros);
+  tableAddAll(&segment->macros, &compiler->macros);
+  compiler->definedMacros = segment->definedMacros;
+  compiler->scanner.defined = parent->scanner.defined;
+  compiler->scanner.definedCount = parent->scanner.definedCount;
+  compiler->scanner.expansionCount = 0;
+  compiler->tokens = parent->tokens;
+  compiler->buffered = true;
+  compiler->nextToken = segment->first;
+  compiler->tokenEnd = segment->last;
+  compiler->nextDefinition = segment->macrosBefore;
+  compiler->builtins = parent->builtins;
+  compiler->inlineCss = parent->inlineCss;
+  compiler->minifyCss = parent->minifyCss;
+  compiler->fingerprintCss = parent->fingerprintCss;
+  compiler->sourcePath = parent->sourcePath;
+  compiler->error[0] = '\0';
+  clearDependencies(compiler);
+  resetIR(&compiler->ir);
+  compiler->retainIR = true;
+
+  if (setjmp(compiler->errorJump) == 0) {
+    compiler->current = nextToken(compiler);
+    compileTokens(compiler);
+    finishTags(compiler, 0);
+    segment->ok = true;
+  }
+
+  // the nodes move to the segment, they are emitted after every worker is
+  // done
+  segment->ir = compiler->ir;
+  initIR(&compiler->ir);
+
+  segment->dependencies = compiler->dependencies;
+  segment->dependencyCount = compiler->dependencyCount;
+  compiler->dependencies = NULL;
+  compiler->dependencyCount = 0;
+  compiler->dependencyCapacity = 0;
+}
+
+/**
+ * @brief Compiles the buffered document with its segments spread over the
+ * pool. The serial pass builds the nodes between the segments, then each
+ * segment's nodes are spliced in after the node it followed, so the output
+ * matches a serial compile byte for byte.
+ *
+ * @return bool false if the document could not be split or any part of it
+ * failed to compile, nothing has been written to the output then.
+ */
+static bool compileParallel(Compiler* compiler) {
+  if (compiler->pool == NULL) {
+    compiler->pool = malloc(sizeof(ThreadPool));
+    initPool(compiler->pool, compiler->jobs);
+  }
+  int workerCount = compiler->pool->workerCount;
+
+  Segment* segments;
+  int count = planSegments(compiler, workerCount, &segments);
+  if (count == 0)
+    return false;
+
+  Compiler* workers = malloc(sizeof(Compiler) * workerCount);
+  // workers count into their own stats, summed once they are done
+  Stats* workerStats = NULL;
+  if (STATS_ON(compiler->stats))
+    workerStats = calloc(workerCount, sizeof(Stats));
+  for (int i = 0; i < workerCount; i++) {
+    initScanner(&workers[i].scanner, NULL, 0, &workers[i].arena);
+    initCompiler(&workers[i]);
+    workers[i].stats = workerStats != NULL ? &workerStats[i] : NULL;
+  }
+  for (int i = 0; i < count; i++)
+    segments[i].workers = workers;
+
+  compiler->segments = segments;
+  compiler->segmentCount = count;
+  compiler->nextSegment = 0;
+  // segments are spliced in after their marks, so nothing is emitted early
+  compiler->retainIR = true;
+
+  // errors only abandon the split, the serial compile reports them
+  jmp_buf errorJump;
+  memcpy(errorJump, compiler->errorJump, sizeof(jmp_buf));
+  bool ok = false;
+  if (setjmp(compiler->errorJump) == 0) {
+    compiler->current = nextToken(compiler);
+    compileTokens(compiler);
+    finishTags(compiler, 0);
+    ok = compiler->nextSegment == count;
+  }
+  memcpy(compiler->errorJump, errorJump, sizeof(jmp_buf));
+  compiler->segments = NULL;
+  compiler->segmentCount = 0;
+
+  // segments already submitted still run even if the serial pass failed
+  poolWait(compiler->pool);
+  for (int i = 0; i < count; i++)
+    ok = ok && segments[i].ok;
+
+  if (ok && workerStats != NULL) {
+    for (int i = 0; i < workerCount; i++)
+      addStats(compiler->stats, &workerStats[i]);
+  }
+  free(workerStats);
+
+  if (ok) {
+    // the old list stays valid in the arena while it is rebuilt
+    char** dependencies = compiler->dependencies;
+    int dependencyCount = compiler->dependencyCount;
+    compiler->dependencies = NULL;
+    compiler->dependencyCount = 0;
+    compiler->dependencyCapacity = 0;
+
+    int dependency = 0;
+    for (int i = 0; i < count; i++) {
+      Segment* segment = &segments[i];
+      for (; dependency < segment->dependencyOffset; dependency++) {
+        addDependency(compiler, dependencies[dependency],
+                      strlen(dependencies[dependency]));
+      }
+      for (int j = 0; j < segment->dependencyCount; j++) {
+        addDependency(compiler, segment->dependencies[j],
+                      strlen(segment->dependencies[j]));
+      }
+    }
+    for (; dependency < dependencyCount; dependency++) {
+      addDependency(compiler, dependencies[dependency],
+                    strlen(dependencies[dependency]));
+    }
+
+    // backwards, so segments sharing a mark end up in order
+    for (int i = count - 1; i >= 0; i--) {
+      Segment* segment = &segments[i];
+      if (segment->ir.first == NULL)
+        continue;
+      segment->ir.last->next = segment->mark->next;
+      segment->mark->next = segment->ir.first;
+      if (compiler->ir.last == segment->mark)
+        compiler->ir.last = segment->ir.last;
+    }
+    emitOutput(compiler);
+  }
+
+  // the segments' dependencies live in the workers' arenas, the tokens and
+  // definitions were only borrowed
+  for (int i = 0; i < workerCount; i++) {
+    workers[i].scanner.defined = NULL;
+    workers[i].scanner.definedCount = 0;
+    initTokenBuffer(&workers[i].tokens);
+    freeCompiler(&workers[i]);
+  }
+  free(workers);
+
+  for (int i = 0; i < count; i++) {
+    freeTable(&segments[i].macros);
+    freeIR(&segments[i].ir);
+  }
+  free(segments);
+  return ok;
 }
 
 /**
  * @brief Zeroes out the compilers memory.
+ *
+ * @param compiler the compiler to initialize.
+ */
+void initCompiler(Compiler* compiler) {
+  compiler->stackTop = compiler->stack;
+  compiler->output = NULL;
+  compiler->instruction = 0;
+  compiler->error[0] = '\0';
+  compiler->builtins = NULL;
+  compiler->inlineCss = false;
+  compiler->minifyCss = false;
+  compiler->fingerprintCss = false;
+  compiler->stats = NULL;
+  compiler->sourcePath = NULL;
+  compiler->dependencies = NULL;
+  compiler->dependencyCount = 0;
+  compiler->dependencyCapacity = 0;
+  initTable(&compiler->macros);
+  compiler->definedMacros = 0;
+  initTokenBuffer(&compiler->tokens);
+  compiler->buffered = false;
+  compiler->currentIndex = -1;
+  compiler->jobs = 1;
+  compiler->pool = NULL;
+  compiler->segments = NULL;
+  compiler->segmentCount = 0;
+  compiler->nextSegment = 0;
+  initIR(&compiler->ir);
+  initArena(&compiler->arena);
+  compiler->retainIR = false;
+  compiler->template = NULL;
+}
+
+/**
+ * @brief Frees the memory owned by the compiler and its scanner.
+ *
+ * @param compiler the compiler to free.
+ */
+void freeCompiler(Compiler* compiler) {
+  freeScanner(&compiler->scanner);
+  freeTable(&compiler->macros);
+  freeTokenBuffer(&compiler->tokens);
+  compiler->dependencies = NULL;
+  compiler->dependencyCount = 0;
+  compiler->dependencyCapacity = 0;
+  freeArena(&compiler->arena);
+  freeIR(&compiler->ir);
+  setCompilerJobs(compiler, 1);
+}
+
+/**
+ * @brief Sets how many threads large in-memory documents are compiled with.
+ * Smaller documents and streams always compile on the calling thread.
+ *
+ * @param compiler the compiler to configure.
+ * @param jobs the number of threads, <= 0 uses one per core and 1 disables
+ * parallel compiles.
+ */
+void setCompilerJobs(Compiler* compiler, int jobs) {
+  if (compiler->pool != NULL) {
+    freePool(compiler->pool);
+    free(compiler->pool);
+    compiler->pool = NULL;
+  }
+  compiler->jobs = jobs <= 0 ? poolDefaultSize() : jobs;
+}
+
+/**
+ * @brief Starts the document's IR with the doctype.
  */
-void initCompiler() {
-  compiler.stackTop = compiler.stack;
-  compiler.output = NULL;
-  compiler.instruction = 0;
-  initTable(&compiler.macros);
+static void startDocument(Compiler* compiler) {
+  resetIR(&compiler->ir);
+  addOutput(compiler, NODE_RAW, "<!DOCTYPE html>", 15);
 }
 
 /**
- * @brief Compiles the file into HTML.
+ * @brief Adds the time spent tokenizing the whole document, and the tokens it
+ * found, to the stats. Streams count their tokens as they are scanned, and
+ * definitions are counted from the scanner afterwards.
+ *
+ * @param start double when tokenizing started.
  */
-void compile(const char* outputFile) {
-  addOutput("<!DOCTYPE html>");
+static void countTokens(Compiler* compiler, double start) {
+  Stats* stats = compiler->stats;
+  stats->millis[STATS_SCAN] += clockMillis() - start;
+  if (!compiler->buffered)
+    return;
+  for (int i = 0; i < compiler->tokens.count; i++) {
+    if (compiler->tokens.types[i] != TOKEN_MACRO)
+      stats->tokens[compiler->tokens.types[i]]++;
+  }
+}
 
-  tableSet(&compiler.macros, "pi", "\"3.14159\"");
+/**
+ * @brief Compiles the scanner's source into HTML, streaming it to the given
+ * sink. The source is parsed into the IR, which the emitter renders in
+ * batches of IR_FLUSH_NODES nodes (streams before every token, memory sinks
+ * once the document is complete). The scanner must be initialized first.
+ *
+ * @param compiler the compiler to run.
+ * @param output the sink to write the generated HTML to.
+ * @return bool false on a compile error, see compiler->error.
+ */
+bool compile(Compiler* compiler, Sink* output) {
+  compiler->output = output;
+  compiler->stackTop = compiler->stack;
+  compiler->instruction = 0;
+  compiler->error[0] = '\0';
+  compiler->definedMacros = 0;
+  compiler->nextToken = 0;
+  compiler->nextDefinition = 0;
+  // the last document's definitions and dependencies
+  resetCompilerArena(compiler);
+  // memory sinks get the whole document, sized up front, in one allocation
+  compiler->retainIR = output->type == SINK_MEMORY;
 
-  compiler.current = scanToken();
+  if (setjmp(compiler->errorJump)) {
+    // what compiled before the error is written, as it was when streaming
+    emitOutput(compiler);
+    flushOutput(compiler);
+    return false;
+  }
 
-  while (compiler.current.type != TOKEN_EOF) {
-    advance();
+  startDocument(compiler);
 
-    printf("%.4d: ", compiler.instruction);
-    printToken(compiler.previous);
+  // in-memory sources are lexed in one pass up front, streams as they arrive
+  double start = STATS_ON(compiler->stats) ? clockMillis() : 0;
+  compiler->buffered = tokenize(&compiler->tokens, &compiler->scanner);
+  compiler->tokenEnd = compiler->tokens.count;
+  if (STATS_ON(compiler->stats))
+    countTokens(compiler, start);
 
-    finishTags(compiler.previous.tab);
+  if (compiler->buffered && compiler->jobs > 1 &&
+      compiler->tokens.count >= PARALLEL_MIN_TOKENS &&
+      compiler->scanner.error == NULL) {
+    // an abandoned split is compiled again, so it must not count twice
+    Stats stats;
+    if (STATS_ON(compiler->stats))
+      stats = *compiler->stats;
+    if (compileParallel(compiler)) {
+      flushOutput(compiler);
+      return true;
+    }
+    if (STATS_ON(compiler->stats))
+      *compiler->stats = stats;
 
-    statement();
+    // start over serially, nothing has been emitted yet
+    compiler->retainIR = output->type == SINK_MEMORY;
+    startDocument(compiler);
+    compiler->stackTop = compiler->stack;
+    clearTable(&compiler->macros);
+    compiler->definedMacros = 0;
+    compiler->nextToken = 0;
+    compiler->nextDefinition = 0;
+    compiler->scanner.expansionCount = 0;
+    compiler->error[0] = '\0';
+    clearDependencies(compiler);
   }
-  printf("%.4d: ", compiler.instruction);
-  printToken(compiler.current);
 
-  finishTags(0);
+  compiler->current = nextToken(compiler);
+  compileTokens(compiler);
 
-  writeOutput(outputFile);
-}
\ No newline at end of file
+  if (compiler->scanner.error != NULL)
+    compileError(compiler, compiler->scanner.error);
+
+  finishTags(compiler, 0);
+
+  emitOutput(compiler);
+  flushOutput(compiler);
+  return true;
+}
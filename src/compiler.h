@@ -2,10 +2,18 @@
 #ifndef CHTML_COMPILER_H
 #define CHTML_COMPILER_H
 
+#include <setjmp.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "ir.h"
+#include "pool.h"
 #include "scanner.h"
+#include "sink.h"
+#include "stats.h"
 #include "table.h"
+#include "template.h"
+#include "tokens.h"
 
 /**
  * @file compiler.h
@@ -14,18 +22,76 @@
  * @since 11/1/2022
  **/
 
+// maximum depth of nested container tags
+#define MAX_DEPTH 256
+
 typedef struct {
-  Token stack[256];
+  Scanner scanner;
+  Token stack[MAX_DEPTH];
   Token* stackTop;
-  char* output;
+  // the document parsed so far, rendered into output by the emitter
+  IR ir;
+  // keep the whole IR until the compile ends rather than emitting it in
+  // batches, for memory sinks and parallel compiles
+  bool retainIR;
+  Sink* output;
+  // when set, the document is written here as a template instead of HTML
+  TemplateWriter* template;
   uint16_t instruction;
   Token previous;
   Token current;
   Table macros;
+  // memory for a single compile (definitions and dependencies), reset when
+  // the next compile starts
+  Arena arena;
+  // how many of the scanner's definitions have been added to macros
+  int definedMacros;
+  // the whole document's tokens, used when the source is in memory
+  TokenBuffer tokens;
+  bool buffered;
+  int nextToken;
+  int nextDefinition;
+  // buffer tokens from tokenEnd on read as EOF, a segment ends there
+  int tokenEnd;
+  // buffer index of the current token, -1 while a macro is replayed
+  int currentIndex;
+  // large in-memory documents are split across this many threads, the pool
+  // is only started once a document is big enough to use it
+  int jobs;
+  ThreadPool* pool;
+  // parts of the document the pool compiles, skipped by the serial pass
+  struct Segment* segments;
+  int segmentCount;
+  int nextSegment;
+  // shared, read-only macros consulted after the document's own
+  Table* builtins;
+  // stylesheets are embedded in style blocks rather than linked, minified
+  // when minifyCss is set too
+  bool inlineCss;
+  bool minifyCss;
+  // linked stylesheets are renamed after their contents' hash, see
+  // fingerprintStylesheet
+  bool fingerprintCss;
+  // the document's file, relative stylesheets are read from beside it (NULL
+  // reads them from the working directory)
+  const char* sourcePath;
+  // where to count what the compile did, NULL (the usual case) counts nothing
+  Stats* stats;
+  // external files the document referenced (css paths), as written
+  char** dependencies;
+  int dependencyCount;
+  int dependencyCapacity;
+  jmp_buf errorJump;
+  char error[256];
 } Compiler;
 
-void initCompiler();
-void compile(const char* outputFile);
-void addMacro(char* name, char* value);
+void initBuiltins(Table* table, Arena* arena);
+void initCompiler(Compiler* compiler);
+void freeCompiler(Compiler* compiler);
+void setCompilerJobs(Compiler* compiler, int jobs);
+bool compile(Compiler* compiler, Sink* output);
+void addMacro(Compiler* compiler, char* name, char* value);
+void addDependency(Compiler* compiler, const char* chars, int length);
+void resetCompilerArena(Compiler* compiler);
 
 #endif
\ No newline at end of file
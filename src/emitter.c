@@ -0,0 +1,196 @@
+/**
+ * @file emitter.c
+ * @author Devin Arena
+ * @brief Renders the IR as HTML. The output's exact size is known before
+ * anything is written, so memory sinks are grown once. Text and attribute
+ * values are escaped on the way out, raw html is not.
+ * @since 11/29/2022
+ **/
+
+#include "emitter.h"
+#include "simd.h"
+
+#define LITERAL(str) str, sizeof(str) - 1
+
+// whole tags, so each is a single write, their lengths are tagLengths + 2
+// and tagLengths + 3
+static const char* const openTags[] = {
+    [TAG_HTML] = "<html>", [TAG_HEAD] = "<head>", [TAG_BODY] = "<body>",
+    [TAG_DIV] = "<div>",   [TAG_TITLE] = "<title>", [TAG_P] = "<p>",
+    [TAG_H1] = "<h1>",     [TAG_H2] = "<h2>",     [TAG_H3] = "<h3>",
+    [TAG_H4] = "<h4>",     [TAG_H5] = "<h5>",     [TAG_H6] = "<h6>",
+};
+
+static const char* const closeTags[] = {
+    [TAG_HTML] = "</html>", [TAG_HEAD] = "</head>", [TAG_BODY] = "</body>",
+    [TAG_DIV] = "</div>",   [TAG_TITLE] = "</title>", [TAG_P] = "</p>",
+    [TAG_H1] = "</h1>",     [TAG_H2] = "</h2>",     [TAG_H3] = "</h3>",
+    [TAG_H4] = "</h4>",     [TAG_H5] = "</h5>",     [TAG_H6] = "</h6>",
+};
+
+// what each byte the escape kernels stop at is replaced with
+static const char* const entities[256] = {
+    ['&'] = "&amp;",  ['<'] = "&lt;",   ['>'] = "&gt;",
+    ['"'] = "&quot;", ['\''] = "&#39;",
+};
+
+static const uint8_t entityLengths[256] = {
+    ['&'] = 5, ['<'] = 4, ['>'] = 4, ['"'] = 6, ['\''] = 5,
+};
+
+typedef const char* (*FindEscapeFn)(const char* current, const char* end);
+
+/**
+ * @brief Computes the length of some characters once escaped.
+ *
+ * @param chars const char* the characters to escape.
+ * @param length size_t the number of characters.
+ * @param find FindEscapeFn the kernel finding the bytes to escape.
+ * @return size_t the escaped length.
+ */
+static size_t escapedLength(const char* chars, size_t length,
+                            FindEscapeFn find) {
+  const char* end = chars + length;
+  while ((chars = find(chars, end)) < end) {
+    length += entityLengths[(unsigned char)*chars] - 1;
+    chars++;
+  }
+  return length;
+}
+
+/**
+ * @brief Writes characters to a sink with the bytes a kernel finds replaced
+ * by their entities. The runs between them, usually all of the text, are
+ * written whole.
+ *
+ * @param sink Sink* the sink to write to.
+ * @param chars const char* the characters to escape.
+ * @param length size_t the number of characters.
+ * @param find FindEscapeFn the kernel finding the bytes to escape.
+ */
+static void writeEscaped(Sink* sink, const char* chars, size_t length,
+                         FindEscapeFn find) {
+  const char* end = chars + length;
+  while (true) {
+    const char* special = find(chars, end);
+    if (special > chars)
+      sinkWrite(sink, chars, special - chars);
+    if (special == end)
+      return;
+
+    unsigned char c = *special;
+    sinkWrite(sink, entities[c], entityLengths[c]);
+    chars = special + 1;
+  }
+}
+
+/**
+ * @brief Computes how many bytes emitting a single node writes.
+ *
+ * @param node const Node* the node.
+ * @return size_t the length of its HTML.
+ */
+size_t emittedNodeLength(const Node* node) {
+  const ScanKernels* kernels = scanKernels();
+  switch (node->type) {
+    case NODE_OPEN:
+      // <tag> or <tag style="...">
+      if (node->chars == NULL)
+        return tagLengths[node->tag] + 2;
+      return tagLengths[node->tag] + 2 + sizeof(" style=\"\"") - 1 +
+             escapedLength(node->chars, node->length,
+                           kernels->findAttributeEscape);
+    case NODE_CLOSE:
+      return tagLengths[node->tag] + 3;
+    case NODE_TEXT:
+      return escapedLength(node->chars, node->length,
+                           kernels->findTextEscape);
+    case NODE_RAW:
+      return node->length;
+    case NODE_LINK:
+      return sizeof("<link rel=\"stylesheet\" href=\"\" />") - 1 +
+             escapedLength(node->chars, node->length,
+                           kernels->findAttributeEscape);
+    case NODE_STYLE:
+      return sizeof("<style></style>") - 1 + node->length;
+    case NODE_MACRO:
+      break;
+  }
+  return 0;
+}
+
+/**
+ * @brief Computes how many bytes emitting a list of nodes writes.
+ *
+ * @param node const Node* the first node of the list.
+ * @return size_t the length of the HTML.
+ */
+size_t emittedLength(const Node* node) {
+  size_t length = 0;
+  for (; node != NULL; node = node->next)
+    length += emittedNodeLength(node);
+  return length;
+}
+
+/**
+ * @brief Writes a single node to a sink as HTML.
+ *
+ * @param node const Node* the node to write.
+ * @param sink Sink* the sink to write to.
+ */
+void emitNode(const Node* node, Sink* sink) {
+  const ScanKernels* kernels = scanKernels();
+  switch (node->type) {
+    case NODE_OPEN:
+      if (node->chars == NULL) {
+        sinkWrite(sink, openTags[node->tag], tagLengths[node->tag] + 2);
+      } else {
+        // the open tag without its '>'
+        sinkWrite(sink, openTags[node->tag], tagLengths[node->tag] + 1);
+        sinkWrite(sink, LITERAL(" style=\""));
+        writeEscaped(sink, node->chars, node->length,
+                     kernels->findAttributeEscape);
+        sinkWrite(sink, LITERAL("\">"));
+      }
+      break;
+    case NODE_CLOSE:
+      sinkWrite(sink, closeTags[node->tag], tagLengths[node->tag] + 3);
+      break;
+    case NODE_TEXT:
+      writeEscaped(sink, node->chars, node->length, kernels->findTextEscape);
+      break;
+    case NODE_RAW:
+      // raw html is the author's markup, it is never escaped
+      sinkWrite(sink, node->chars, node->length);
+      break;
+    case NODE_LINK:
+      sinkWrite(sink, LITERAL("<link rel=\"stylesheet\" href=\""));
+      writeEscaped(sink, node->chars, node->length,
+                   kernels->findAttributeEscape);
+      sinkWrite(sink, LITERAL("\" />"));
+      break;
+    case NODE_STYLE:
+      // css has no entities, the stylesheet is the author's like raw html
+      sinkWrite(sink, LITERAL("<style>"));
+      sinkWrite(sink, node->chars, node->length);
+      sinkWrite(sink, LITERAL("</style>"));
+      break;
+    case NODE_MACRO:
+      break;
+  }
+}
+
+/**
+ * @brief Writes a list of nodes to a sink as HTML.
+ *
+ * @param node const Node* the first node of the list.
+ * @param sink Sink* the sink to write to.
+ */
+void emitNodes(const Node* node, Sink* sink) {
+  // only memory sinks have anything to size, the others stream
+  if (sink->type == SINK_MEMORY)
+    sinkReserve(sink, emittedLength(node));
+
+  for (; node != NULL; node = node->next)
+    emitNode(node, sink);
+}
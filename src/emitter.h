@@ -0,0 +1,21 @@
+/**
+ * @file emitter.h
+ * @author Devin Arena
+ * @brief Header for the emitter, which renders the IR as HTML.
+ * @since 11/29/2022
+ **/
+
+#ifndef CHTML_EMITTER_H
+#define CHTML_EMITTER_H
+
+#include <stddef.h>
+
+#include "ir.h"
+#include "sink.h"
+
+size_t emittedNodeLength(const Node* node);
+size_t emittedLength(const Node* node);
+void emitNode(const Node* node, Sink* sink);
+void emitNodes(const Node* node, Sink* sink);
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file gzip.c
+ * @author Devin Arena
+ * @brief Compresses output into a .gz file as it is written, so precompressed
+ * pages come out of the same pass as the HTML instead of a second one over
+ * the finished file.
+ * @since 12/3/2022
+ **/
+
+#include <string.h>
+
+#include "gzip.h"
+#include "timer.h"
+
+// zlib's window bits plus 16 asks for a gzip header and trailer
+#define GZIP_WINDOW_BITS (15 + 16)
+#define GZIP_MEMORY_LEVEL 8
+
+/**
+ * @brief Starts a gzip stream into a file.
+ *
+ * @param writer GzipWriter* the writer to initialize.
+ * @param file FILE* the file to write to, closed by closeGzipWriter.
+ * @param level int the compression level, clamped to 1-9.
+ * @return bool false if zlib could not be initialized.
+ */
+bool initGzipWriter(GzipWriter* writer, FILE* file, int level) {
+  if (level < Z_BEST_SPEED)
+    level = Z_BEST_SPEED;
+  if (level > Z_BEST_COMPRESSION)
+    level = Z_BEST_COMPRESSION;
+
+  writer->file = file;
+  writer->failed = false;
+  writer->millis = 0;
+  writer->stream.zalloc = Z_NULL;
+  writer->stream.zfree = Z_NULL;
+  writer->stream.opaque = Z_NULL;
+  if (deflateInit2(&writer->stream, level, Z_DEFLATED, GZIP_WINDOW_BITS,
+                   GZIP_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    // a zeroed stream makes deflateEnd a no-op
+    memset(&writer->stream, 0, sizeof(writer->stream));
+    writer->failed = true;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Runs deflate over the pending input, writing out each buffer it
+ * fills.
+ *
+ * @param writer GzipWriter* the writer to run.
+ * @param flush int Z_NO_FLUSH while writing, Z_FINISH at the end.
+ */
+static void deflateAll(GzipWriter* writer, int flush) {
+  z_stream* stream = &writer->stream;
+  do {
+    stream->next_out = writer->buffer;
+    stream->avail_out = GZIP_BUFFER_SIZE;
+    int status = deflate(stream, flush);
+    if (status == Z_STREAM_ERROR) {
+      writer->failed = true;
+      return;
+    }
+
+    size_t length = GZIP_BUFFER_SIZE - stream->avail_out;
+    if (length > 0 && fwrite(writer->buffer, 1, length, writer->file) !=
+                          length) {
+      writer->failed = true;
+      return;
+    }
+  } while (stream->avail_out == 0);
+}
+
+/**
+ * @brief Compresses some output.
+ *
+ * @param writer GzipWriter* the writer to compress into.
+ * @param chars const char* the characters to compress.
+ * @param length size_t the number of characters.
+ */
+void gzipWrite(GzipWriter* writer, const char* chars, size_t length) {
+  if (writer->failed || length == 0)
+    return;
+
+  double start = clockMillis();
+  // zlib never writes through next_in, its type just predates const
+  writer->stream.next_in = (Bytef*)chars;
+  writer->stream.avail_in = length;
+  deflateAll(writer, Z_NO_FLUSH);
+  writer->millis += clockMillis() - start;
+}
+
+/**
+ * @brief Finishes the gzip stream and closes its file.
+ *
+ * @param writer GzipWriter* the writer to close.
+ * @return bool false if anything failed to compress or write.
+ */
+bool closeGzipWriter(GzipWriter* writer) {
+  double start = clockMillis();
+  if (!writer->failed) {
+    writer->stream.next_in = Z_NULL;
+    writer->stream.avail_in = 0;
+    deflateAll(writer, Z_FINISH);
+  }
+  deflateEnd(&writer->stream);
+  if (fclose(writer->file) != 0)
+    writer->failed = true;
+  writer->millis += clockMillis() - start;
+  return !writer->failed;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file gzip.h
+ * @author Devin Arena
+ * @brief Header for the gzip writer sinks feed a compressed copy of their
+ * output to.
+ * @since 12/3/2022
+ **/
+
+#ifndef CHTML_GZIP_H
+#define CHTML_GZIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <zlib.h>
+
+// compressed bytes buffered before they are written to the file
+#define GZIP_BUFFER_SIZE 16384
+// what gzip itself defaults to
+#define GZIP_DEFAULT_LEVEL 6
+
+typedef struct GzipWriter {
+  z_stream stream;
+  FILE* file;
+  bool failed;
+  // time spent compressing, writing the file included
+  double millis;
+  unsigned char buffer[GZIP_BUFFER_SIZE];
+} GzipWriter;
+
+bool initGzipWriter(GzipWriter* writer, FILE* file, int level);
+void gzipWrite(GzipWriter* writer, const char* chars, size_t length);
+bool closeGzipWriter(GzipWriter* writer);
+
+#endif
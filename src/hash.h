@@ -0,0 +1,34 @@
+/**
+ * @file hash.h
+ * @author Devin Arena
+ * @brief 64 bit FNV-1a hashing for content addressed files.
+ * @since 11/22/2022
+ **/
+
+#ifndef CHTML_HASH_H
+#define CHTML_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH64_SEED 14695981039346656037ull
+
+/**
+ * @brief Continues a 64 bit FNV-1a hash over more bytes, start with
+ * HASH64_SEED.
+ *
+ * @param hash uint64_t the hash so far.
+ * @param bytes const void* the bytes to hash.
+ * @param length size_t the number of bytes.
+ * @return uint64_t the updated hash.
+ */
+static inline uint64_t hash64(uint64_t hash, const void* bytes, size_t length) {
+  const unsigned char* chars = bytes;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= chars[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+#endif
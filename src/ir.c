@@ -0,0 +1,133 @@
+/**
+ * @file ir.c
+ * @author Devin Arena
+ * @brief The compiler's intermediate representation: a list of nodes in
+ * document order, allocated from an arena so a whole compile is released at
+ * once, plus passes that rewrite it before it is emitted.
+ * @since 11/29/2022
+ **/
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "ir.h"
+
+const char* const tagNames[] = {
+    [TAG_HTML] = "html", [TAG_HEAD] = "head", [TAG_BODY] = "body",
+    [TAG_DIV] = "div",   [TAG_TITLE] = "title", [TAG_P] = "p",
+    [TAG_H1] = "h1",     [TAG_H2] = "h2",     [TAG_H3] = "h3",
+    [TAG_H4] = "h4",     [TAG_H5] = "h5",     [TAG_H6] = "h6",
+};
+
+const uint8_t tagLengths[] = {
+    [TAG_HTML] = 4, [TAG_HEAD] = 4, [TAG_BODY] = 4, [TAG_DIV] = 3,
+    [TAG_TITLE] = 5, [TAG_P] = 1,   [TAG_H1] = 2,   [TAG_H2] = 2,
+    [TAG_H3] = 2,   [TAG_H4] = 2,   [TAG_H5] = 2,   [TAG_H6] = 2,
+};
+
+/**
+ * @brief Initializes an empty IR.
+ *
+ * @param ir IR* the IR to initialize.
+ */
+void initIR(IR* ir) {
+  initArena(&ir->arena);
+  ir->first = NULL;
+  ir->last = NULL;
+  ir->count = 0;
+}
+
+/**
+ * @brief Frees every node of the IR at once.
+ *
+ * @param ir IR* the IR to free.
+ */
+void freeIR(IR* ir) {
+  freeArena(&ir->arena);
+  ir->first = NULL;
+  ir->last = NULL;
+  ir->count = 0;
+}
+
+/**
+ * @brief Drops every node but keeps the arena's memory for the next
+ * document.
+ *
+ * @param ir IR* the IR to reset.
+ */
+void resetIR(IR* ir) {
+  resetArena(&ir->arena);
+  ir->first = NULL;
+  ir->last = NULL;
+  ir->count = 0;
+}
+
+/**
+ * @brief Appends a node to the IR. Characters are referenced, not copied,
+ * they must outlive the IR (or at least its emission).
+ *
+ * @param ir IR* the IR to append to.
+ * @param type NodeType the node's type.
+ * @param chars const char* the node's characters, if any.
+ * @param length size_t the number of characters.
+ * @return Node* the new node.
+ */
+Node* addNode(IR* ir, NodeType type, const char* chars, size_t length) {
+  Node* node = arenaAlloc(&ir->arena, sizeof(Node));
+  node->next = NULL;
+  node->chars = chars;
+  node->length = length;
+  node->type = type;
+  node->tag = 0;
+
+  if (ir->last == NULL)
+    ir->first = node;
+  else
+    ir->last->next = node;
+  ir->last = node;
+  ir->count++;
+  return node;
+}
+
+/**
+ * @brief Merges runs of adjacent text nodes into one. Runs that are already
+ * contiguous in memory are simply widened, others are joined in the arena.
+ *
+ * @param ir IR* the IR to rewrite.
+ */
+void mergeText(IR* ir) {
+  for (Node* node = ir->first; node != NULL; node = node->next) {
+    if (node->type != NODE_TEXT)
+      continue;
+
+    Node* next = node->next;
+    if (next == NULL || next->type != NODE_TEXT)
+      continue;
+
+    size_t length = node->length;
+    size_t merged = 0;
+    Node* end = next;
+    bool contiguous = true;
+    while (end != NULL && end->type == NODE_TEXT) {
+      contiguous = contiguous && end->chars == node->chars + length;
+      length += end->length;
+      end = end->next;
+      merged++;
+    }
+
+    if (!contiguous) {
+      char* joined = arenaAlloc(&ir->arena, length);
+      size_t offset = 0;
+      for (Node* part = node; part != end; part = part->next) {
+        memcpy(joined + offset, part->chars, part->length);
+        offset += part->length;
+      }
+      node->chars = joined;
+    }
+    node->length = length;
+    node->next = end;
+    ir->count -= merged;
+    if (end == NULL)
+      ir->last = node;
+  }
+}
@@ -0,0 +1,77 @@
+/**
+ * @file ir.h
+ * @author Devin Arena
+ * @brief Header for the intermediate representation the compiler builds and
+ * the emitter renders.
+ * @since 11/29/2022
+ **/
+
+#ifndef CHTML_IR_H
+#define CHTML_IR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+typedef enum {
+  TAG_HTML,
+  TAG_HEAD,
+  TAG_BODY,
+  TAG_DIV,
+  TAG_TITLE,
+  TAG_P,
+  TAG_H1,
+  TAG_H2,
+  TAG_H3,
+  TAG_H4,
+  TAG_H5,
+  TAG_H6,
+} Tag;
+
+typedef enum {
+  // an element's start tag, chars is its inline style (NULL for none),
+  // escaped as an attribute value when emitted
+  NODE_OPEN,
+  // an element's end tag
+  NODE_CLOSE,
+  // document text, escaped when emitted
+  NODE_TEXT,
+  // html written through as is (raw html blocks, the doctype)
+  NODE_RAW,
+  // a stylesheet link, chars is the href (escaped like the style)
+  NODE_LINK,
+  // an inlined stylesheet, chars is the css, written as is in a style block
+  NODE_STYLE,
+  // where a macro call's nodes begin, chars is the macro's name, emits nothing
+  NODE_MACRO,
+} NodeType;
+
+// elements are start and end tag pairs rather than subtrees, indentation
+// closes containers independently of the text tags a macro may open them in
+typedef struct Node {
+  struct Node* next;
+  const char* chars;
+  uint32_t length;
+  uint8_t type;
+  uint8_t tag;
+} Node;
+
+// nodes in document order, all allocated from the arena
+typedef struct {
+  Arena arena;
+  Node* first;
+  Node* last;
+  size_t count;
+} IR;
+
+extern const char* const tagNames[];
+extern const uint8_t tagLengths[];
+
+void initIR(IR* ir);
+void freeIR(IR* ir);
+void resetIR(IR* ir);
+Node* addNode(IR* ir, NodeType type, const char* chars, size_t length);
+void mergeText(IR* ir);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file keyword.c
+ * @author Devin Arena
+ * @brief Classifies identifiers as element keywords straight from the source
+ * span, through the perfect hash table generated from keywords.def.
+ * @since 11/26/2022
+ **/
+
+#include <string.h>
+
+#include "keyword.h"
+#include "keywords.h"
+
+/**
+ * @brief Finds the keyword an identifier names, if any. One hash, one
+ * compare and no allocation.
+ *
+ * @param chars the identifier, need not be NUL terminated.
+ * @param length the length of the identifier.
+ * @return TokenType the keyword's token type, or TOKEN_IDENTIFIER.
+ */
+TokenType keywordType(const char* chars, int length) {
+  if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH)
+    return TOKEN_IDENTIFIER;
+
+  const Keyword* keyword =
+      &keywordTable[keywordHash(chars, length, KEYWORD_SEED, KEYWORD_BITS)];
+  if (keyword->length != length || memcmp(keyword->name, chars, length) != 0)
+    return TOKEN_IDENTIFIER;
+
+  return (TokenType)keyword->type;
+}
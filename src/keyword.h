@@ -0,0 +1,43 @@
+/**
+ * @file keyword.h
+ * @author Devin Arena
+ * @brief Header for the keyword recognizer.
+ * @since 11/26/2022
+ **/
+
+#ifndef CHTML_KEYWORD_H
+#define CHTML_KEYWORD_H
+
+#include <stdint.h>
+
+#include "scanner.h"
+
+typedef struct {
+  const char* name;
+  uint8_t length;
+  uint8_t type;
+} Keyword;
+
+/**
+ * @brief Hashes an identifier by its length, first, second and last
+ * characters. Shared with the generator so both agree on every slot.
+ *
+ * @param chars the identifier, at least one character long.
+ * @param length the length of the identifier.
+ * @param seed the multiplier picked by the generator.
+ * @param bits log2 of the table size.
+ * @return uint32_t the slot of the identifier.
+ */
+static inline uint32_t keywordHash(const char* chars, int length,
+                                   uint32_t seed, int bits) {
+  uint32_t key = (uint32_t)(uint8_t)length |
+                 (uint32_t)(uint8_t)chars[0] << 8 |
+                 (uint32_t)(uint8_t)chars[length > 1] << 16 |
+                 (uint32_t)(uint8_t)chars[length - 1] << 24;
+  key ^= key >> 15;
+  return (key * seed) >> (32 - bits);
+}
+
+TokenType keywordType(const char* chars, int length);
+
+#endif
@@ -8,64 +8,434 @@
  * @date 2022-10-28
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#include "compiler.h"
-#include "scanner.h"
+#include "cache.h"
+#include "chtml.h"
+#include "gzip.h"
+#include "server.h"
+#include "site.h"
+#include "source.h"
+#include "timer.h"
+#include "tokens.h"
+#include "watch.h"
 
-static char* readFile(const char* path) {
-  FILE* file = fopen(path, "rb");
-  // file may not exist or be readable
-  if (!file) {
-    printf("Could not open file '%s'\n", path);
-    exit(74);
-  }
+// heap allocations are counted while this is set, for --stats
+static bool countingAllocations = false;
+static uint64_t allocationCount = 0;
 
-  // get file size and go back to beginning
-  fseek(file, 0L, SEEK_END);
-  size_t fileSize = ftell(file);
-  rewind(file);
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
 
-  // allocate memory for file contents
-  char* buffer = (char*)malloc(fileSize + 1);
-  // may not have enough memory to read whole file
-  if (buffer == NULL) {
-    fprintf(stderr, "Not enough memory to read '%s'\n", path);
-    exit(74);
-  }
+/**
+ * @brief Counts an allocation if --stats asked for it. The allocators below
+ * are linked in place of the C library's (see the Makefile), a flag that is
+ * never set is all they cost otherwise.
+ */
+static inline void countAllocation() {
+  if (__builtin_expect(countingAllocations, 0))
+    __atomic_fetch_add(&allocationCount, 1, __ATOMIC_RELAXED);
+}
 
-  // read file contents into buffer
-  size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
+void* __wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
 
-  // if bytes read is not equal to file size, something went wrong
-  if (bytesRead < fileSize) {
-    fprintf(stderr, "Could not read file '%s'\n", path);
-    exit(74);
+void* __wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+  countAllocation();
+  return __real_realloc(pointer, size);
+}
+
+/**
+ * @brief Prints the stats of a build to stderr, out of the way of output
+ * written to stdout.
+ *
+ * @param stats Stats* the stats to print.
+ * @param json bool whether to print them as JSON.
+ */
+static void reportStats(Stats* stats, bool json) {
+  countingAllocations = false;
+  stats->heapAllocations = allocationCount;
+  stats->countsHeap = true;
+  printStats(stats, stderr, json);
+}
+
+/**
+ * @brief Prints the command line usage.
+ *
+ * @param name the name the program was run as.
+ */
+static void usage(const char* name) {
+  printf("Usage: %s [--stream] [--jobs n] <file|-> [output|-]\n", name);
+  printf("       %s --emit-compiled <file|-> [output.chc|-]\n", name);
+  printf("       %s <file.chc> [output|-]\n", name);
+  printf("       %s --site <input dir> <output dir> [--jobs n]\n", name);
+  printf("       %s --watch <file|dir> [output|output dir]\n", name);
+  printf("       %s --tokens <file|->\n", name);
+  printf("       %s --serve <socket>\n", name);
+  printf("       %s --client <socket> <file|-> [output|-]\n", name);
+  printf("Options: --cache-dir <dir> reuse output of unchanged pages\n");
+  printf("         --gzip [--gzip-level n] also write output.gz, compressed "
+         "as it is written\n");
+  printf("         --inline-css [--minify-css] embed stylesheets instead of "
+         "linking them\n");
+  printf("         --fingerprint-css link stylesheets by content hash, copied "
+         "beside the output\n");
+  printf("                           and listed in asset-manifest.json\n");
+  printf("         --stats[=json] report time per phase and compile counters "
+         "on stderr\n");
+}
+
+/**
+ * @brief Checks whether a path names a precompiled template.
+ *
+ * @param path the path to check.
+ * @return bool true if the path ends in ".chc".
+ */
+static bool isTemplatePath(const char* path) {
+  size_t length = strlen(path);
+  return length > 4 && strcmp(path + length - 4, ".chc") == 0;
+}
+
+/**
+ * @brief Prints every token of a document, one per line.
+ *
+ * @param path the document, "-" for stdin.
+ * @return int the process exit code.
+ */
+static int dumpFile(const char* path) {
+  Source source;
+  if (!openSource(&source, path)) {
+    fprintf(stderr, "Could not read file '%s': %s\n", path, strerror(errno));
+    return 74;
   }
 
-  // null terminate buffer
-  buffer[bytesRead] = '\0';
+  Arena arena;
+  initArena(&arena);
+  Scanner scanner;
+  initScanner(&scanner, source.chars, source.length, &arena);
+  TokenBuffer tokens;
+  initTokenBuffer(&tokens);
 
-  // close file
-  fclose(file);
+  bool ok = tokenize(&tokens, &scanner);
+  if (ok)
+    dumpTokens(&tokens, stdout);
+  else
+    fprintf(stderr, "'%s' is too large to tokenize\n", path);
 
-  return buffer;
+  freeTokenBuffer(&tokens);
+  freeScanner(&scanner);
+  freeArena(&arena);
+  closeSource(&source);
+  return ok ? 0 : 1;
 }
 
 int main(int argc, const char* argv[]) {
-  if (argc <= 1) {
-    printf("Usage: %s <file> [output]\n", argv[0]);
+  const char* inputName = NULL;
+  const char* outputName = NULL;
+  bool stream = false;
+  bool site = false;
+  bool watch = false;
+  bool tokens = false;
+  bool emitCompiled = false;
+  int jobs = 0;
+  int gzipLevel = 0;
+  bool inlineCss = false;
+  bool minifyCss = false;
+  bool fingerprintCss = false;
+  const char* serveSocket = NULL;
+  const char* clientSocket = NULL;
+  const char* cacheDir = NULL;
+  bool showStats = false;
+  bool statsJson = false;
+
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stream") == 0) {
+      stream = true;
+    } else if (strcmp(argv[i], "--site") == 0) {
+      site = true;
+    } else if (strcmp(argv[i], "--watch") == 0) {
+      watch = true;
+    } else if (strcmp(argv[i], "--tokens") == 0) {
+      tokens = true;
+    } else if (strcmp(argv[i], "--emit-compiled") == 0) {
+      emitCompiled = true;
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--gzip") == 0) {
+      if (gzipLevel == 0)
+        gzipLevel = GZIP_DEFAULT_LEVEL;
+    } else if (strcmp(argv[i], "--gzip-level") == 0 && i + 1 < argc) {
+      gzipLevel = atoi(argv[++i]);
+      if (gzipLevel < 1 || gzipLevel > 9) {
+        fprintf(stderr, "Gzip level must be between 1 and 9\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--inline-css") == 0) {
+      inlineCss = true;
+    } else if (strcmp(argv[i], "--minify-css") == 0) {
+      minifyCss = true;
+    } else if (strcmp(argv[i], "--fingerprint-css") == 0) {
+      fingerprintCss = true;
+    } else if (strcmp(argv[i], "--stats") == 0 ||
+               strcmp(argv[i], "--stats=text") == 0) {
+      showStats = true;
+    } else if (strcmp(argv[i], "--stats=json") == 0) {
+      showStats = true;
+      statsJson = true;
+    } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+      cacheDir = argv[++i];
+    } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      serveSocket = argv[++i];
+    } else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+      clientSocket = argv[++i];
+    } else if (positional == 0) {
+      inputName = argv[i];
+      positional++;
+    } else if (positional == 1) {
+      outputName = argv[i];
+      positional++;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // minifying implies inlining, fingerprinted stylesheets are linked
+  if (fingerprintCss && (inlineCss || minifyCss)) {
+    fprintf(stderr, "--fingerprint-css cannot be used with --inline-css or "
+                    "--minify-css\n");
+    return 1;
+  }
+  ChtmlCssMode cssMode = CHTML_CSS_LINK;
+  if (fingerprintCss)
+    cssMode = CHTML_CSS_FINGERPRINT;
+  else if (minifyCss)
+    cssMode = CHTML_CSS_INLINE_MINIFIED;
+  else if (inlineCss)
+    cssMode = CHTML_CSS_INLINE;
+
+  if (serveSocket != NULL)
+    return serve(serveSocket);
+
+  if (tokens && inputName != NULL)
+    return dumpFile(inputName);
+
+  if (watch && inputName != NULL) {
+    // pages are rebuilt in place as they change, the warm context already
+    // skips what a cache would
+    if (cacheDir != NULL) {
+      fprintf(stderr, "--cache-dir cannot be used with --watch\n");
+      return 1;
+    }
+
+    Stats stats;
+    initStats(&stats);
+    ChtmlContext* context = chtmlCreate();
+    chtmlSetJobs(context, jobs);
+    chtmlSetGzip(context, gzipLevel);
+    chtmlSetCssMode(context, cssMode);
+    if (showStats)
+      chtmlSetStats(context, &stats);
+    int code = watchBuild(inputName,
+                          outputName != NULL ? outputName : "index.html",
+                          context, showStats ? &stats : NULL, statsJson);
+    chtmlDestroy(context);
+    return code;
+  }
+
+  if (inputName == NULL || (site && outputName == NULL)) {
+    usage(argv[0]);
     return 1;
   }
 
-  char* file = readFile(argv[1]);
-  const char* outputName = argc >= 3 ? argv[2] : "index.html";
+  Cache cache;
+  if (cacheDir != NULL && !openCache(&cache, cacheDir)) {
+    fprintf(stderr, "Could not open cache '%s': %s\n", cacheDir,
+            strerror(errno));
+    return 74;
+  }
+
+  // counted from here, everything before is argument parsing
+  Stats stats;
+  initStats(&stats);
+  countingAllocations = showStats;
+
+  if (site) {
+    int failed =
+        buildSite(inputName, outputName, jobs, gzipLevel, cssMode,
+                  cacheDir ? &cache : NULL, showStats ? &stats : NULL);
+    if (cacheDir != NULL)
+      closeCache(&cache);
+    // times are summed over pages, so they can add up to more than the build
+    if (showStats)
+      reportStats(&stats, statsJson);
+    return failed == 0 ? 0 : 1;
+  }
+
+  if (outputName == NULL)
+    outputName = emitCompiled ? "index.chc" : "index.html";
+
+  if (clientSocket != NULL)
+    return runClient(clientSocket, inputName, outputName);
+
+  // templates are rendered rather than compiled
+  bool isTemplate = !emitCompiled && isTemplatePath(inputName);
+
+  // stdin is always streamed, it may never end and cannot be mapped, unless
+  // the whole document is needed to write a template
+  bool isStdin = strcmp(inputName, "-") == 0;
+  stream = !emitCompiled && !isTemplate && (stream || isStdin);
+  bool toStdout = strcmp(outputName, "-") == 0;
+
+  ChtmlContext* context = chtmlCreate();
+  // large documents are split across cores, streams stay serial
+  chtmlSetJobs(context, jobs);
+  chtmlSetGzip(context, gzipLevel);
+  chtmlSetCssMode(context, cssMode);
+  if (showStats)
+    chtmlSetStats(context, &stats);
+  // streamed and template sources read their stylesheets from beside them
+  if (!isStdin)
+    chtmlSetSourcePath(context, inputName);
+
+  // file to file is the common case, the library handles it end to end
+  if (!stream && !toStdout && !emitCompiled && !isTemplate) {
+    bool compiled;
+    if (cacheDir != NULL) {
+      bool hit;
+      compiled =
+          cacheCompileFile(&cache, context, inputName, outputName, &hit);
+      closeCache(&cache);
+    } else {
+      compiled = chtmlCompileFile(context, inputName, outputName);
+    }
+
+    if (!compiled) {
+      fprintf(stderr, "Compile error: %s\n", chtmlError(context));
+      exit(1);
+    }
+    if (cssMode == CHTML_CSS_FINGERPRINT &&
+        !writePageManifest(context, outputName))
+      exit(74);
+    chtmlDestroy(context);
+    if (showStats)
+      reportStats(&stats, statsJson);
+    return 0;
+  }
+
+  double start = clockMillis();
+  Source source = {0};
+  int inputFd = -1;
+  if (stream) {
+    inputFd = isStdin ? STDIN_FILENO : open(inputName, O_RDONLY);
+    if (inputFd < 0) {
+      fprintf(stderr, "Could not read file '%s': %s\n", inputName,
+              strerror(errno));
+      exit(74);
+    }
+  } else if (!isTemplate && !openSource(&source, inputName)) {
+    fprintf(stderr, "Could not read file '%s': %s\n", inputName,
+            strerror(errno));
+    exit(74);
+  }
+  // streams are read as they are scanned, templates by the library
+  if (!stream && !isTemplate)
+    stats.millis[STATS_READ] += clockMillis() - start;
 
-  initScanner(file);
-  initCompiler();
+  // "-" streams the document to stdout instead of a named file
+  Sink output;
+  if (toStdout) {
+    initFdSink(&output, STDOUT_FILENO);
+  } else if (!openFileSink(&output, outputName)) {
+    fprintf(stderr, "Could not open output file '%s'\n", outputName);
+    exit(74);
+  }
 
-  compile(outputName);
+  // streamed and rendered pages are gzipped on the way out too
+  GzipWriter gzip;
+  char gzipName[4096];
+  bool gzipped = gzipLevel > 0 && !toStdout && !emitCompiled;
+  if (gzipped) {
+    snprintf(gzipName, sizeof(gzipName), "%s.gz", outputName);
+    FILE* gzipFile = fopen(gzipName, "wb");
+    if (gzipFile == NULL) {
+      fprintf(stderr, "Could not open output file '%s'\n", gzipName);
+      exit(74);
+    }
+    initGzipWriter(&gzip, gzipFile, gzipLevel);
+    output.gzip = &gzip;
+  }
 
+  bool compiled;
+  if (isTemplate)
+    compiled = chtmlRenderTemplateFile(context, inputName, &output);
+  else if (emitCompiled)
+    compiled = chtmlCompileTemplate(context, source.chars, source.length,
+                                    &output);
+  else if (stream)
+    compiled = chtmlCompileStream(context, inputFd, &output);
+  else
+    compiled = chtmlCompile(context, source.chars, source.length, &output);
+  // fingerprinted stylesheets go beside the page they are linked from
+  if (compiled && !toStdout && !emitCompiled &&
+      !chtmlPlaceStylesheets(context, outputName))
+    compiled = false;
+  if (!compiled) {
+    fprintf(stderr, "%s error: %s\n", isTemplate ? "Render" : "Compile",
+            chtmlError(context));
+    // don't leave a truncated document behind
+    closeSink(&output);
+    if (!toStdout)
+      remove(outputName);
+    if (gzipped) {
+      closeGzipWriter(&gzip);
+      remove(gzipName);
+    }
+    exit(1);
+  }
+
+  start = clockMillis();
+  if (!closeSink(&output)) {
+    fprintf(stderr, "Could not write output '%s'\n", outputName);
+    exit(74);
+  }
+  if (gzipped && !closeGzipWriter(&gzip)) {
+    fprintf(stderr, "Could not write output '%s'\n", gzipName);
+    exit(74);
+  }
+  stats.millis[STATS_WRITE] += clockMillis() - start;
+  if (gzipped)
+    addGzipMillis(&stats, gzip.millis);
+
+  if (!toStdout && !emitCompiled && cssMode == CHTML_CSS_FINGERPRINT &&
+      !writePageManifest(context, outputName))
+    exit(74);
+  chtmlDestroy(context);
+
+  if (stream) {
+    if (!isStdin)
+      close(inputFd);
+  } else if (!isTemplate) {
+    closeSource(&source);
+  }
+
+  if (showStats)
+    reportStats(&stats, statsJson);
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,222 @@
+/**
+ * @file path.c
+ * @author Devin Arena
+ * @brief Small helpers for building paths, creating directories and placing
+ * files.
+ * @since 11/22/2022
+ **/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "path.h"
+#include "source.h"
+
+/**
+ * @brief Joins two path components with a '/'.
+ *
+ * @param dir const char* the directory, may be empty.
+ * @param name const char* the name to append.
+ * @return char* the joined path, must be freed.
+ */
+char* joinPath(const char* dir, const char* name) {
+  size_t dirLength = strlen(dir);
+  size_t nameLength = strlen(name);
+  char* path = malloc(dirLength + nameLength + 2);
+  if (dirLength == 0) {
+    memcpy(path, name, nameLength + 1);
+    return path;
+  }
+  memcpy(path, dir, dirLength);
+  path[dirLength] = '/';
+  memcpy(path + dirLength + 1, name, nameLength + 1);
+  return path;
+}
+
+/**
+ * @brief Creates a directory and any missing parents.
+ *
+ * @param path const char* the directory to create.
+ * @return bool false if a directory could not be created.
+ */
+bool makeDirectories(const char* path) {
+  char* copy = strdup(path);
+  for (char* c = copy + 1; *c != '\0'; c++) {
+    if (*c != '/')
+      continue;
+    *c = '\0';
+    if (mkdir(copy, 0755) != 0 && errno != EEXIST) {
+      free(copy);
+      return false;
+    }
+    *c = '/';
+  }
+  bool ok = mkdir(copy, 0755) == 0 || errno == EEXIST;
+  free(copy);
+  return ok;
+}
+
+/**
+ * @brief Resolves a path relative to the directory containing another file,
+ * used for paths written inside a source file.
+ *
+ * @param file const char* the file the path was written in.
+ * @param path const char* the path, returned as is if absolute.
+ * @param length size_t the length of path.
+ * @return char* the resolved path, must be freed.
+ */
+char* resolvePath(const char* file, const char* path, size_t length) {
+  const char* slash = strrchr(file, '/');
+  size_t dirLength = path[0] == '/' || slash == NULL ? 0 : slash - file + 1;
+
+  char* resolved = malloc(dirLength + length + 1);
+  memcpy(resolved, file, dirLength);
+  memcpy(resolved + dirLength, path, length);
+  resolved[dirLength + length] = '\0';
+  return resolved;
+}
+
+/**
+ * @brief Normalizes a relative path in place, dropping "." components and
+ * folding "name/.." pairs. Leading ".." components are kept.
+ *
+ * @param path char* the path to normalize.
+ */
+void normalizePath(char* path) {
+  char* out = path;
+  // the start of the part of out that can't be folded any further
+  char* floor = path;
+  const char* in = path;
+  while (*in != '\0') {
+    const char* end = strchr(in, '/');
+    size_t length = end == NULL ? strlen(in) : (size_t)(end - in);
+
+    if (length == 0 || (length == 1 && in[0] == '.')) {
+      // empty and "." components say nothing
+    } else if (length == 2 && in[0] == '.' && in[1] == '.' && out > floor) {
+      // drop the last component written, and the slash before it
+      out--;
+      while (out > floor && out[-1] != '/')
+        out--;
+      if (out > floor)
+        out--;
+    } else {
+      if (out > path)
+        *out++ = '/';
+      memmove(out, in, length);
+      out += length;
+      if (length == 2 && in[0] == '.' && in[1] == '.')
+        floor = out;
+    }
+
+    in += length;
+    if (*in == '/')
+      in++;
+  }
+  *out = '\0';
+}
+
+/**
+ * @brief Canonicalizes a path by resolving its directory, the file itself need
+ * not exist (it may have just been deleted or renamed over).
+ *
+ * @param path const char* the path to canonicalize.
+ * @return char* the canonical path, or NULL if the directory doesn't exist.
+ */
+char* canonicalPath(const char* path) {
+  const char* slash = strrchr(path, '/');
+  char* dir = slash == NULL ? strdup(".") : strndup(path, slash - path);
+  const char* name = slash == NULL ? path : slash + 1;
+
+  char* resolved = realpath(dir[0] == '\0' ? "/" : dir, NULL);
+  free(dir);
+  if (resolved == NULL)
+    return NULL;
+
+  // the root directory already ends in a slash
+  size_t dirLength = strcmp(resolved, "/") == 0 ? 0 : strlen(resolved);
+  size_t nameLength = strlen(name);
+  char* canonical = malloc(dirLength + nameLength + 2);
+  memcpy(canonical, resolved, dirLength);
+  canonical[dirLength] = '/';
+  memcpy(canonical + dirLength + 1, name, nameLength + 1);
+  free(resolved);
+  return canonical;
+}
+
+/**
+ * @brief Writes a file atomically by renaming a temporary file into place.
+ *
+ * @param path const char* the file to write.
+ * @param chars const char* the contents.
+ * @param length size_t the length of the contents.
+ * @return bool false if the file could not be written.
+ */
+bool writeAtomically(const char* path, const char* chars,
+                            size_t length) {
+  size_t pathLength = strlen(path);
+  char* tempPath = malloc(pathLength + 8);
+  memcpy(tempPath, path, pathLength);
+  memcpy(tempPath + pathLength, ".XXXXXX", 8);
+
+  int fd = mkstemp(tempPath);
+  if (fd < 0) {
+    free(tempPath);
+    return false;
+  }
+
+  bool ok = length == 0 || write(fd, chars, length) == (ssize_t)length;
+  ok = close(fd) == 0 && ok;
+  ok = ok && rename(tempPath, path) == 0;
+  if (!ok)
+    remove(tempPath);
+  free(tempPath);
+  return ok;
+}
+
+/**
+ * @brief Places a file at a new path, hard linking when possible and copying
+ * otherwise (different file systems).
+ *
+ * @param from const char* the existing file.
+ * @param to const char* the path to place it at, replaced atomically.
+ * @return bool false if the file could not be placed.
+ */
+bool linkOrCopy(const char* from, const char* to) {
+  // already linked, e.g. an unchanged page from the last build
+  struct stat fromInfo;
+  struct stat toInfo;
+  if (stat(from, &fromInfo) == 0 && stat(to, &toInfo) == 0 &&
+      fromInfo.st_dev == toInfo.st_dev && fromInfo.st_ino == toInfo.st_ino)
+    return true;
+
+  static unsigned linkCounter = 0;
+  unsigned id = __atomic_fetch_add(&linkCounter, 1, __ATOMIC_RELAXED);
+
+  size_t pathLength = strlen(to) + 32;
+  char* tempPath = malloc(pathLength);
+  snprintf(tempPath, pathLength, "%s.%d.%u", to, (int)getpid(), id);
+
+  // link beside the target then rename, so the target is never missing
+  remove(tempPath);
+  if (link(from, tempPath) == 0) {
+    bool ok = rename(tempPath, to) == 0;
+    // rename is a no-op if both names already link the same file
+    remove(tempPath);
+    free(tempPath);
+    return ok;
+  }
+  free(tempPath);
+
+  Source source;
+  if (!openSource(&source, from))
+    return false;
+  bool ok = writeAtomically(to, source.chars, source.length);
+  closeSource(&source);
+  return ok;
+}
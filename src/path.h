@@ -0,0 +1,22 @@
+/**
+ * @file path.h
+ * @author Devin Arena
+ * @brief Header for path and file placement helpers.
+ * @since 11/22/2022
+ **/
+
+#ifndef CHTML_PATH_H
+#define CHTML_PATH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+char* joinPath(const char* dir, const char* name);
+bool makeDirectories(const char* path);
+char* resolvePath(const char* file, const char* path, size_t length);
+char* canonicalPath(const char* path);
+void normalizePath(char* path);
+bool writeAtomically(const char* path, const char* chars, size_t length);
+bool linkOrCopy(const char* from, const char* to);
+
+#endif
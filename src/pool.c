@@ -0,0 +1,248 @@
+/**
+ * @file pool.c
+ * @author Devin Arena
+ * @brief A small work-stealing thread pool. Every worker owns a queue, tasks
+ * are dealt to the queues round robin and a worker whose queue runs dry
+ * steals from the others, so one slow task never leaves the rest idle.
+ * @since 11/18/2022
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+typedef struct {
+  ThreadPool* pool;
+  int index;
+} Worker;
+
+/**
+ * @brief Adds a task to the back of a queue, growing it if needed.
+ *
+ * @param queue TaskQueue* the queue to push to.
+ * @param task Task the task to push.
+ */
+static void pushTask(TaskQueue* queue, Task task) {
+  pthread_mutex_lock(&queue->lock);
+  if (queue->count == queue->capacity) {
+    int capacity = queue->capacity < 8 ? 8 : queue->capacity * 2;
+    Task* tasks = malloc(sizeof(Task) * capacity);
+    if (tasks == NULL) {
+      fprintf(stderr, "Not enough memory to queue task\n");
+      exit(74);
+    }
+    // unwrap the ring into the new array
+    for (int i = 0; i < queue->count; i++)
+      tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+    free(queue->tasks);
+    queue->tasks = tasks;
+    queue->head = 0;
+    queue->capacity = capacity;
+  }
+  queue->tasks[(queue->head + queue->count) % queue->capacity] = task;
+  queue->count++;
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Takes a task from a queue. Owners take from the front so their own
+ * work runs in submission order, thieves take from the back so they are
+ * least likely to contend with the owner.
+ *
+ * @param queue TaskQueue* the queue to take from.
+ * @param steal bool true if the caller does not own the queue.
+ * @param task Task* set to the task taken.
+ * @return bool false if the queue was empty.
+ */
+static bool takeTask(TaskQueue* queue, bool steal, Task* task) {
+  pthread_mutex_lock(&queue->lock);
+  if (queue->count == 0) {
+    pthread_mutex_unlock(&queue->lock);
+    return false;
+  }
+
+  if (steal) {
+    *task = queue->tasks[(queue->head + queue->count - 1) % queue->capacity];
+  } else {
+    *task = queue->tasks[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+  }
+  queue->count--;
+  pthread_mutex_unlock(&queue->lock);
+  return true;
+}
+
+/**
+ * @brief Finds the next task for a worker, its own queue first and then the
+ * others in order.
+ *
+ * @param pool ThreadPool* the pool.
+ * @param index int the worker looking for work.
+ * @param task Task* set to the task found.
+ * @return bool false if every queue was empty.
+ */
+static bool findTask(ThreadPool* pool, int index, Task* task) {
+  if (takeTask(&pool->queues[index], false, task))
+    return true;
+
+  for (int i = 1; i < pool->workerCount; i++) {
+    int victim = (index + i) % pool->workerCount;
+    if (takeTask(&pool->queues[victim], true, task))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Worker thread loop, runs tasks until the pool is stopped.
+ *
+ * @param arg void* the Worker describing this thread.
+ * @return void* always NULL.
+ */
+static void* runWorker(void* arg) {
+  Worker* worker = arg;
+  ThreadPool* pool = worker->pool;
+
+  while (true) {
+    Task task;
+    if (findTask(pool, worker->index, &task)) {
+      pthread_mutex_lock(&pool->lock);
+      pool->queued--;
+      pthread_mutex_unlock(&pool->lock);
+
+      task.fn(task.arg, worker->index);
+
+      pthread_mutex_lock(&pool->lock);
+      if (--pool->unfinished == 0)
+        pthread_cond_broadcast(&pool->idle);
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued == 0 && !pool->stopping)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    bool stopping = pool->stopping && pool->queued == 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (stopping)
+      break;
+  }
+
+  free(worker);
+  return NULL;
+}
+
+/**
+ * @brief Returns the number of online cores, the default pool size.
+ *
+ * @return int the number of cores, at least 1.
+ */
+int poolDefaultSize() {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores < 1 ? 1 : (int)cores;
+}
+
+/**
+ * @brief Starts a pool with the given number of worker threads.
+ *
+ * @param pool ThreadPool* the pool to initialize.
+ * @param workers int the number of workers, <= 0 uses one per core.
+ */
+void initPool(ThreadPool* pool, int workers) {
+  if (workers <= 0)
+    workers = poolDefaultSize();
+
+  pool->workerCount = workers;
+  pool->nextQueue = 0;
+  pool->queued = 0;
+  pool->unfinished = 0;
+  pool->stopping = false;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  pool->queues = malloc(sizeof(TaskQueue) * workers);
+  pool->threads = malloc(sizeof(pthread_t) * workers);
+  if (pool->queues == NULL || pool->threads == NULL) {
+    fprintf(stderr, "Not enough memory to start thread pool\n");
+    exit(74);
+  }
+
+  for (int i = 0; i < workers; i++) {
+    TaskQueue* queue = &pool->queues[i];
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->tasks = NULL;
+    queue->head = 0;
+    queue->count = 0;
+    queue->capacity = 0;
+  }
+
+  for (int i = 0; i < workers; i++) {
+    Worker* worker = malloc(sizeof(Worker));
+    worker->pool = pool;
+    worker->index = i;
+    pthread_create(&pool->threads[i], NULL, runWorker, worker);
+  }
+}
+
+/**
+ * @brief Queues a task. Tasks are dealt to the workers' queues round robin.
+ *
+ * @param pool ThreadPool* the pool to run the task on.
+ * @param fn TaskFn the function to run, given arg and the worker index.
+ * @param arg void* passed to fn.
+ */
+void poolSubmit(ThreadPool* pool, TaskFn fn, void* arg) {
+  pthread_mutex_lock(&pool->lock);
+  int index = pool->nextQueue;
+  pool->nextQueue = (pool->nextQueue + 1) % pool->workerCount;
+  pool->unfinished++;
+  // the task is pushed before it is counted, under the lock workers count
+  // with, so a worker woken for it can always take it
+  pushTask(&pool->queues[index], (Task){fn, arg});
+  pool->queued++;
+  pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Blocks until every submitted task has finished.
+ *
+ * @param pool ThreadPool* the pool to wait on.
+ */
+void poolWait(ThreadPool* pool) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->unfinished > 0)
+    pthread_cond_wait(&pool->idle, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Waits for outstanding tasks, stops the workers and frees the pool.
+ *
+ * @param pool ThreadPool* the pool to free.
+ */
+void freePool(ThreadPool* pool) {
+  poolWait(pool);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 0; i < pool->workerCount; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  for (int i = 0; i < pool->workerCount; i++) {
+    pthread_mutex_destroy(&pool->queues[i].lock);
+    free(pool->queues[i].tasks);
+  }
+  free(pool->queues);
+  free(pool->threads);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  pthread_cond_destroy(&pool->idle);
+}
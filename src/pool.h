@@ -0,0 +1,49 @@
+/**
+ * @file pool.h
+ * @author Devin Arena
+ * @brief Header for the work-stealing thread pool.
+ * @since 11/18/2022
+ **/
+
+#ifndef CHTML_POOL_H
+#define CHTML_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef void (*TaskFn)(void* arg, int worker);
+
+typedef struct {
+  TaskFn fn;
+  void* arg;
+} Task;
+
+typedef struct {
+  pthread_mutex_t lock;
+  Task* tasks;
+  int head;
+  int count;
+  int capacity;
+} TaskQueue;
+
+typedef struct {
+  int workerCount;
+  pthread_t* threads;
+  TaskQueue* queues;
+  int nextQueue;
+  // guards the counters below and the two condition variables
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t idle;
+  int queued;
+  int unfinished;
+  bool stopping;
+} ThreadPool;
+
+int poolDefaultSize();
+void initPool(ThreadPool* pool, int workers);
+void freePool(ThreadPool* pool);
+void poolSubmit(ThreadPool* pool, TaskFn fn, void* arg);
+void poolWait(ThreadPool* pool);
+
+#endif
@@ -1,11 +1,16 @@
 
 #include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include "compiler.h"
+#include "common.h"
+#include "keyword.h"
 #include "scanner.h"
+#include "simd.h"
 
 /**
  * @file scanner.c
@@ -15,15 +20,117 @@
  * @since 10/30/2022
  **/
 
-Scanner scanner;
+static Token scanNext(Scanner* scanner);
+
+/**
+ * @brief Hands a buffer that may still back a live token to the retired list.
+ * Retired buffers are freed once the compiler can no longer reference them.
+ *
+ * @param buffer char* the buffer to retire, may be NULL.
+ */
+static void retireBuffer(Scanner* scanner, char* buffer) {
+  if (buffer == NULL)
+    return;
+
+  if (scanner->retiredCount == scanner->retiredCapacity) {
+    scanner->retiredCapacity =
+        scanner->retiredCapacity < 4 ? 4 : scanner->retiredCapacity * 2;
+    scanner->retired =
+        realloc(scanner->retired, sizeof(char*) * scanner->retiredCapacity);
+  }
+  scanner->retired[scanner->retiredCount++] = buffer;
+}
+
+/**
+ * @brief Frees every retired buffer. Only safe at a token boundary, when the
+ * compiler holds no token older than the one last returned by scanToken.
+ */
+static void freeRetired(Scanner* scanner) {
+  for (int i = 0; i < scanner->retiredCount; i++)
+    free(scanner->retired[i]);
+  scanner->retiredCount = 0;
+}
+
+/**
+ * @brief Reads the next chunk of a streamed source. Everything from the start
+ * of the token being scanned (or the mark, if set) onwards is copied into a
+ * fresh buffer so tokens never straddle two buffers, the old buffer is retired
+ * since the compiler may still hold a token pointing into it.
+ *
+ * @return bool true if any new characters were read.
+ */
+static bool refill(Scanner* scanner) {
+  if (scanner->fd < 0 || scanner->exhausted)
+    return false;
+
+  const char* keep = scanner->mark != NULL ? scanner->mark : scanner->start;
+  size_t kept = scanner->end - keep;
+
+  size_t capacity = SCANNER_CHUNK * 2;
+  while (capacity < kept + SCANNER_CHUNK)
+    capacity *= 2;
+
+  char* buffer = malloc(capacity);
+  if (buffer == NULL) {
+    fprintf(stderr, "Not enough memory to buffer input\n");
+    exit(74);
+  }
+  if (kept > 0)
+    memcpy(buffer, keep, kept);
+
+  size_t length = kept;
+  while (length < kept + SCANNER_CHUNK) {
+    ssize_t count = read(scanner->fd, buffer + length, capacity - length);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      // treated as the end of input, the compiler reports the failure
+      scanner->error = "Could not read input";
+      scanner->exhausted = true;
+      break;
+    }
+    if (count == 0) {
+      scanner->exhausted = true;
+      break;
+    }
+    length += count;
+  }
+
+  scanner->start = buffer + (scanner->start - keep);
+  scanner->current = buffer + (scanner->current - keep);
+  if (scanner->mark != NULL)
+    scanner->mark = buffer;
+  scanner->end = buffer + length;
+
+  retireBuffer(scanner, scanner->buffer);
+  scanner->buffer = buffer;
+  scanner->capacity = capacity;
+
+  return length > kept;
+}
+
+/**
+ * @brief Checks if the scanner has consumed all of its input, refilling
+ * streamed sources. The source is not required to be NUL terminated (it may
+ * be a mapped file).
+ *
+ * @return bool true if there are no characters left.
+ */
+static bool isAtEnd(Scanner* scanner) {
+  if (scanner->current < scanner->end)
+    return false;
+  return !refill(scanner);
+}
 
 /**
  * @brief Peek at the current character in the source code.
  *
- * @return char the current character.
+ * @return char the current character, '\0' at the end of the source.
  */
-char peek() {
-  return *scanner.current;
+static char peek(Scanner* scanner) {
+  if (isAtEnd(scanner))
+    return '\0';
+  return *scanner->current;
 }
 
 /**
@@ -31,89 +138,246 @@ char peek() {
  *
  * @return char the next character in the source code.
  */
-char peekNext() {
-  if (peek() == '\0')
+static char peekNext(Scanner* scanner) {
+  if (scanner->current + 1 >= scanner->end && !refill(scanner))
+    return '\0';
+  if (scanner->current + 1 >= scanner->end)
     return '\0';
-  return scanner.current[1];
+  return scanner->current[1];
 }
 
 /**
  * @brief Advance the scanner to the next character.
  */
-static void advance() {
-  scanner.current++;
-  scanner.col++;
+static void advance(Scanner* scanner) {
+  scanner->current++;
+  scanner->col++;
 }
 
 /**
  * @brief Counts the number of tabs until the next non-tab character.
  */
-static void countIndentation() {
-  scanner.tabs = 0;
+static void countIndentation(Scanner* scanner) {
+  scanner->tabs = 0;
+
+  while (true) {
+    const char* stop =
+        scanner->kernels->skipTabs(scanner->current, scanner->end);
+    scanner->tabs += stop - scanner->current;
+    scanner->col += stop - scanner->current;
+    scanner->current = stop;
+    if (stop < scanner->end || !refill(scanner))
+      break;
+  }
 
-  char c;
-  while ((c = peek()) == '\r' || c == '\t') {
-    scanner.tabs++;
+  scanner->start = scanner->current;
+}
 
-    advance();
+/**
+ * @brief Zeroes out the scanner's memory.
+ *
+ * @param scanner the scanner to initialize.
+ * @param source the source code to scan.
+ * @param length the number of characters in the source.
+ * @param arena where definitions are allocated, it must outlive the tokens
+ * and macros the scanner hands out.
+ */
+void initScanner(Scanner* scanner,
+                 const char* source,
+                 size_t length,
+                 Arena* arena) {
+  scanner->start = source;
+  scanner->current = source;
+  scanner->end = source + length;
+  scanner->mark = NULL;
+  scanner->line = 1;
+  scanner->col = 0;
+  scanner->fd = -1;
+  scanner->exhausted = true;
+  scanner->buffer = NULL;
+  scanner->capacity = 0;
+  scanner->retired = NULL;
+  scanner->retiredCount = 0;
+  scanner->retiredCapacity = 0;
+  scanner->error = NULL;
+  scanner->source = source;
+  scanner->arena = arena;
+  scanner->defined = NULL;
+  scanner->definedCount = 0;
+  scanner->definedCapacity = 0;
+  scanner->expansionCount = 0;
+  scanner->kernels = scanKernels();
+  countIndentation(scanner);
+}
+
+/**
+ * @brief Sets the scanner up to read its source from a descriptor in
+ * SCANNER_CHUNK sized pieces, so the whole input never has to be in memory.
+ *
+ * @param scanner the scanner to initialize.
+ * @param fd the descriptor to read from (stdin, a pipe or a file).
+ * @param arena where definitions are allocated.
+ */
+void initStreamScanner(Scanner* scanner, int fd, Arena* arena) {
+  initScanner(scanner, NULL, 0, arena);
+  scanner->fd = fd;
+  scanner->exhausted = false;
+  countIndentation(scanner);
+}
+
+/**
+ * @brief Frees any buffers owned by the scanner. Definitions belong to the
+ * scanner's arena and are released with it.
+ */
+void freeScanner(Scanner* scanner) {
+  scanner->defined = NULL;
+  scanner->definedCount = 0;
+  scanner->definedCapacity = 0;
+  scanner->expansionCount = 0;
+  freeRetired(scanner);
+  free(scanner->retired);
+  free(scanner->buffer);
+  scanner->retired = NULL;
+  scanner->retiredCapacity = 0;
+  scanner->buffer = NULL;
+}
+
+/**
+ * @brief Records a token of a macro body relative to the body's first line.
+ * Tokens on the first line take the call site's indentation, later lines are
+ * indented relative to the first.
+ *
+ * @param arena where the macro is allocated.
+ * @param macro the macro being defined.
+ * @param token the token to record.
+ * @param line the line the body starts on.
+ * @param tab the indentation of the body's first line.
+ * @param origin where the body's text starts, token spans are offsets from it.
+ */
+static void addMacroToken(Arena* arena, Macro* macro, Token token, int line,
+                          int tab, const char* origin) {
+  if (macro->count == macro->capacity) {
+    macro->capacity = macro->capacity < 8 ? 8 : macro->capacity * 2;
+    MacroToken* tokens =
+        arenaAlloc(arena, sizeof(MacroToken) * macro->capacity);
+    if (macro->count > 0)
+      memcpy(tokens, macro->tokens, sizeof(MacroToken) * macro->count);
+    macro->tokens = tokens;
   }
 
-  scanner.start = scanner.current;
+  int relative = token.line == line ? 0 : token.tab - tab;
+  MacroToken* stored = &macro->tokens[macro->count++];
+  stored->type = token.type;
+  stored->tab = relative < 0 ? 0 : relative;
+  stored->line = token.line - line;
+  stored->start = token.start - origin;
+  stored->length = token.length;
 }
 
 /**
- * @brief Updates values for the next line.
+ * @brief Copies characters into an arena as a NUL terminated string.
+ *
+ * @param arena the arena to copy into.
+ * @param chars the characters to copy.
+ * @param length the number of characters.
+ * @return char* the copy.
  */
-static void newLine() {
-  scanner.line++;
-  scanner.col = 0;
-  countIndentation();
+static char* copyString(Arena* arena, const char* chars, size_t length) {
+  char* copy = arenaAlloc(arena, length + 1);
+  memcpy(copy, chars, length);
+  copy[length] = '\0';
+  return copy;
 }
 
 /**
- * @brief Zeroes out the scanner's memory.
+ * @brief Allocates an empty macro.
  *
- * @param source the source code to scan.
+ * @param arena where the macro is allocated.
+ * @param name the macro's name, already in the arena, may be NULL.
+ * @return Macro* the macro.
  */
-void initScanner(char* source) {
-  scanner.start = source;
-  scanner.current = source;
-  scanner.line = 1;
-  countIndentation();
+static Macro* allocateMacro(Arena* arena, char* name) {
+  Macro* macro = arenaAlloc(arena, sizeof(Macro));
+  macro->name = name;
+  macro->text = NULL;
+  macro->tokens = NULL;
+  macro->count = 0;
+  macro->capacity = 0;
+  return macro;
 }
 
-void insertMacro(int tabs, char* source) {
-  char* newSource = malloc(strlen(source) * 2);
-  int totalLength = 0;
-  int lineNum = 0;
-  // split the given source string by newlines
-  char* token = strtok(source, "\n");
-  while (token != NULL) {
-    // add the tabs to the beginning of all but the first line
-    if (lineNum > 0) {
-      int length = strlen(token) + tabs + 1;
-      char* line = malloc(length);
-      for (int i = 0; i < tabs; i++) {
-        line[i] = '\t';
-      }
-      strcat(line, token);
-      line[tabs] = '\0';
-      strcat(newSource, line);
-      totalLength += length;
-    } else {
-      strcpy(newSource, token);
-      totalLength += strlen(token);
-    }
-    lineNum++;
-    token = strtok(NULL, "\n");
+/**
+ * @brief Tokenizes a macro body given as source text, used for macros that
+ * do not come from an @name block (built in macros). Definitions inside the
+ * text are ignored.
+ *
+ * @param arena where the macro is allocated, it lives as long as the arena.
+ * @param text the body, NUL terminated.
+ * @return Macro* the macro.
+ */
+Macro* newMacro(Arena* arena, const char* text) {
+  Macro* macro = allocateMacro(arena, NULL);
+  macro->text = copyString(arena, text, strlen(text));
+
+  Scanner scanner;
+  initScanner(&scanner, macro->text, strlen(macro->text), arena);
+
+  int line = scanner.line;
+  int tab = scanner.tabs;
+  for (Token token = scanNext(&scanner); token.type != TOKEN_EOF;
+       token = scanNext(&scanner)) {
+    if (token.type != TOKEN_MACRO)
+      addMacroToken(arena, macro, token, line, tab, macro->text);
   }
-  totalLength += strlen(scanner.start) + 1;
-  newSource = realloc(newSource, totalLength);
-  newSource[totalLength - 1] = '\0';
-  strcat(newSource, scanner.start);
-  scanner.start = newSource;
-  scanner.current = scanner.start;
-  printf("\tAFTER INSERTION:\n%s\n", scanner.start);
+
+  freeScanner(&scanner);
+  return macro;
+}
+
+/**
+ * @brief Starts replaying a macro's tokens in place of the call. The source
+ * is not touched, it resumes once every open expansion has been replayed, so
+ * a call costs one copy per body token and no lexing.
+ *
+ * @param macro the macro to replay, must outlive the expansion.
+ * @param call the token that started the call, its line and indentation are
+ * applied to the body.
+ * @return bool false if too many expansions are already open.
+ */
+bool expandMacro(Scanner* scanner, const Macro* macro, Token call) {
+  if (scanner->expansionCount == MAX_EXPANSION_DEPTH)
+    return false;
+
+  Expansion* expansion = &scanner->expansions[scanner->expansionCount++];
+  expansion->macro = macro;
+  expansion->next = 0;
+  expansion->line = call.line;
+  expansion->col = call.col;
+  expansion->tab = call.tab;
+#ifdef DEBUG_PRINT_TOKENS
+  printf("\tEXPANDING:\n%s\n", macro->text);
+#endif
+  return true;
+}
+
+/**
+ * @brief Produces the next token of an expansion.
+ *
+ * @param expansion the expansion to take the token from.
+ * @return Token the token, placed at the call site.
+ */
+static Token replayToken(Expansion* expansion) {
+  const Macro* macro = expansion->macro;
+  const MacroToken* stored = &macro->tokens[expansion->next++];
+
+  Token token;
+  token.type = (TokenType)stored->type;
+  token.line = expansion->line + stored->line;
+  token.col = expansion->col;
+  token.tab = expansion->tab + stored->tab;
+  token.start = macro->text + stored->start;
+  token.length = stored->length;
+  return token;
 }
 
 /**
@@ -121,16 +385,41 @@ void insertMacro(int tabs, char* source) {
  *
  * @return int the number of tabs.
  */
-static void skipWhitespace() {
-  char c;
-  while ((c = peek()) != '\0' &&
-         (c == ' ' || c == '\r' || c == '\t' || c == '\n')) {
-    advance();
+static void skipWhitespace(Scanner* scanner) {
+  const ScanKernels* kernels = scanner->kernels;
+
+  // a line's indentation is the run of tabs straight after its newline, it
+  // may continue into the next refill
+  bool indenting = false;
+  while (true) {
+    const char* from = scanner->current;
+    const char* stop = kernels->skipBlank(from, scanner->end);
+
+    const char* last;
+    int newlines = kernels->countNewlines(from, stop, &last);
+    if (newlines > 0) {
+      scanner->line += newlines;
+      scanner->col = 0;
+      scanner->tabs = 0;
+      from = last + 1;
+      indenting = true;
+    }
+    if (indenting) {
+      const char* tabs = kernels->skipTabs(from, stop);
+      scanner->tabs += tabs - from;
+      indenting = tabs == stop;
+    }
+    scanner->col += stop - from;
+    scanner->current = stop;
 
-    if (c == '\n')
-      newLine();
+    // whitespace is never part of a token, so it need not survive a refill
+    if (stop < scanner->end)
+      break;
+    scanner->start = stop;
+    if (!refill(scanner))
+      break;
   }
-  scanner.start = scanner.current;
+  scanner->start = scanner->current;
 }
 
 /**
@@ -139,14 +428,14 @@ static void skipWhitespace() {
  * @param type the type of the token.
  * @return Token the token.
  */
-static Token makeToken(TokenType type) {
+static Token makeToken(Scanner* scanner, TokenType type) {
   Token token;
   token.type = type;
-  token.line = scanner.line;
-  token.length = (int)(scanner.current - scanner.start);
-  token.col = scanner.col - token.length;
-  token.tab = scanner.tabs;
-  token.start = scanner.start;
+  token.line = scanner->line;
+  token.length = (int)(scanner->current - scanner->start);
+  token.col = scanner->col - token.length;
+  token.tab = scanner->tabs;
+  token.start = scanner->start;
   return token;
 }
 
@@ -157,250 +446,203 @@ static Token makeToken(TokenType type) {
  * @param end the character that ends the token.
  * @return Token the generated token.
  */
-static Token quotedToken(TokenType type, char end) {
-  advance();
-
-  while (peek() != end) {
-    if (peek() == '\n') {
-      scanner.line++;
-      scanner.col = 0;
-    } else if (peek() == '\0') {
-      return makeToken(TOKEN_ERROR);
+static Token quotedToken(Scanner* scanner, TokenType type, char end) {
+  advance(scanner);
+
+  while (true) {
+    int newlines;
+    const char* last;
+    const char* stop = scanner->kernels->findQuote(
+        scanner->current, scanner->end, end, &newlines, &last);
+    // the column counts the newline itself inside quotes
+    if (newlines > 0) {
+      scanner->line += newlines;
+      scanner->col = stop - last;
+    } else {
+      scanner->col += stop - scanner->current;
     }
-    advance();
+    scanner->current = stop;
+
+    if (stop < scanner->end)
+      break;
+    if (!refill(scanner))
+      return makeToken(scanner, TOKEN_ERROR);
   }
 
-  Token token = makeToken(type);
+  Token token = makeToken(scanner, type);
 
-  advance();
-  scanner.start = scanner.current;
+  advance(scanner);
+  scanner->start = scanner->current;
 
   return token;
 }
 
-Token macro() {
-  advance();
+static Token macro(Scanner* scanner) {
+  // pin the definition so refills keep it in one buffer while its extent is
+  // found, positions are kept as offsets since refills move the mark
+  bool outermost = scanner->mark == NULL;
+  if (outermost)
+    scanner->mark = scanner->start;
+  size_t atOffset = scanner->start - scanner->mark;
+
+  advance(scanner);
 
   char c;
-  while (isdigit((c = peek())) || isalpha(c)) {
-    advance();
+  while (isdigit((c = peek(scanner))) || isalpha(c)) {
+    advance(scanner);
   }
 
-  int nameLen = scanner.current - scanner.start;
-  char* name = malloc(nameLen * sizeof(char*));
-  strncpy(name, scanner.start + 1, nameLen - 1);
-  name[nameLen - 1] = '\0';
-
-  scanner.start = scanner.current;
-  skipWhitespace();
-
-  char* start = scanner.start;
-
-  Token token = scanToken();
-  while (token.tab > 0) {
-    printf("TOKEN: %s %d %d\n", token.start, token.length, token.tab);
-    token = scanToken();
-  }
-  char* end = scanner.current - token.length;
-
-  int len = end - start + 1;
-  char* text = malloc(len * sizeof(char*));
-  strncpy(text, start, len - 1);
-  for (int i = len - 3; i >= 0; i--) {
-    if (text[i] != ' ' && text[i] != '\t' && text[i] != '\r' && text[i] != '\n' && text[i] != '\0') {
-      text[i + 1] = '\0';
-      break;
+  int nameLen = scanner->current - scanner->start;
+  char* name = copyString(scanner->arena, scanner->start + 1, nameLen - 1);
+
+  scanner->start = scanner->current;
+  skipWhitespace(scanner);
+
+  size_t startOffset = scanner->start - scanner->mark;
+  int line = scanner->line;
+  int tab = scanner->tabs;
+
+  // tokens are recorded as offsets from the body's start, which stay valid
+  // once the body is copied out of the (possibly refilled) source
+  Macro* macro = allocateMacro(scanner->arena, name);
+  Token token = scanNext(scanner);
+  while (token.tab > 0 && token.type != TOKEN_EOF) {
+    // errors and empty identifiers do not advance the scanner, the
+    // definition is dropped and the token reported in its place
+    if (token.type == TOKEN_ERROR ||
+        (token.type == TOKEN_IDENTIFIER && token.length == 0)) {
+      if (outermost)
+        scanner->mark = NULL;
+      return token;
     }
+#ifdef DEBUG_PRINT_TOKENS
+    printf("TOKEN: %.*s %d %d\n", token.length, token.start, token.length,
+           token.tab);
+#endif
+    if (token.type != TOKEN_MACRO)
+      addMacroToken(scanner->arena, macro, token, line, tab,
+                    scanner->mark + startOffset);
+    token = scanNext(scanner);
   }
+  const char* at = scanner->mark + atOffset;
+  const char* start = scanner->mark + startOffset;
+  const char* end = token.start;
+  if (outermost)
+    scanner->mark = NULL;
+
+  macro->text = copyString(scanner->arena, start, end - start);
+
+#ifdef DEBUG_PRINT_TOKENS
+  printf("DEFINED MACRO '%s' WITH TEXT '%s'\n", name, macro->text);
+#endif
+  // replaced definitions stay alive with the arena, the compiler may still
+  // hold a token from an earlier call
+  if (scanner->definedCount == scanner->definedCapacity) {
+    scanner->definedCapacity =
+        scanner->definedCapacity < 8 ? 8 : scanner->definedCapacity * 2;
+    Macro** defined =
+        arenaAlloc(scanner->arena, sizeof(Macro*) * scanner->definedCapacity);
+    if (scanner->definedCount > 0)
+      memcpy(defined, scanner->defined,
+             sizeof(Macro*) * scanner->definedCount);
+    scanner->defined = defined;
+  }
+  scanner->defined[scanner->definedCount++] = macro;
 
-  printf("DEFINED MACRO '%s' WITH TEXT '%s'\n", name, text);
-  scanner.start = start;
-  scanner.current = end;
-
-  Token macroToken = makeToken(TOKEN_MACRO);
-
-  addMacro(name, text);
+  // a definition directly after this one has already been scanned, its
+  // token (which starts at its '@') stands in for both
+  if (token.type == TOKEN_MACRO)
+    return token;
 
-  scanner.start = scanner.current;
+  scanner->start = at;
+  scanner->current = end;
+  Token macroToken = makeToken(scanner, TOKEN_MACRO);
+  scanner->start = scanner->current;
 
   return macroToken;
 }
 
+/**
+ * @brief Takes the next token of the innermost macro expansion, closing
+ * expansions that have run out. The source resumes once none are left.
+ *
+ * @param token set to the replayed token.
+ * @return bool false if no expansion is open.
+ */
+bool expansionToken(Scanner* scanner, Token* token) {
+  while (scanner->expansionCount > 0) {
+    Expansion* expansion = &scanner->expansions[scanner->expansionCount - 1];
+    if (expansion->next < expansion->macro->count) {
+      *token = replayToken(expansion);
+      return true;
+    }
+    scanner->expansionCount--;
+  }
+  return false;
+}
+
 /**
  * @brief Scans the next token (generates a token based on the current character
  * of the input string)
  *
  * @return Token the next token.
  */
-Token scanToken() {
-  skipWhitespace();
+Token scanToken(Scanner* scanner) {
+  // the compiler only holds the previous token, which lives in the current
+  // buffer (or a macro), so anything retired before this call is unreachable
+  freeRetired(scanner);
+
+  Token token;
+  if (expansionToken(scanner, &token))
+    return token;
+  return scanNext(scanner);
+}
+
+/**
+ * @brief Scans the next token without releasing retired buffers, used while a
+ * token is being built from several scans (comments and macro bodies).
+ *
+ * @return Token the next token.
+ */
+static Token scanNext(Scanner* scanner) {
+  skipWhitespace(scanner);
+
+  if (isAtEnd(scanner))
+    return makeToken(scanner, TOKEN_EOF);
 
-  char c = peek();
+  char c = peek(scanner);
   switch (c) {
-    case '\0':
-      return makeToken(TOKEN_EOF);
     case '"':
-      return quotedToken(TOKEN_TEXT, '"');
+      return quotedToken(scanner, TOKEN_TEXT, '"');
     case '`':
-      return quotedToken(TOKEN_RAW_HTML, '`');
+      return quotedToken(scanner, TOKEN_RAW_HTML, '`');
     case '/':
-      if (peekNext() == '/') {
-        while (peek() != '\0' && peek() != '\n')
-          advance();
-        return scanToken();
+      if (peekNext(scanner) == '/') {
+        while (!isAtEnd(scanner) && peek(scanner) != '\n')
+          advance(scanner);
+        return scanNext(scanner);
       }
-      return makeToken(TOKEN_ERROR);
+      return makeToken(scanner, TOKEN_ERROR);
     case '(':
-      advance();
-      return makeToken(TOKEN_LEFT_PAREN);
+      advance(scanner);
+      return makeToken(scanner, TOKEN_LEFT_PAREN);
     case ')':
-      advance();
-      return makeToken(TOKEN_RIGHT_PAREN);
+      advance(scanner);
+      return makeToken(scanner, TOKEN_RIGHT_PAREN);
     case '!':
-      advance();
-      return makeToken(TOKEN_EXCLAMATION);
+      advance(scanner);
+      return makeToken(scanner, TOKEN_EXCLAMATION);
     case '@':
-      return macro();
+      return macro(scanner);
     default: {
-      while (isdigit((c = peek())) || isalpha(c)) {
-        advance();
+      while (isdigit((c = peek(scanner))) || isalpha(c)) {
+        advance(scanner);
       }
 
-      size_t length = scanner.current - scanner.start + 1;
-      if (length == 2 && *scanner.start == 'p')
-        return makeToken(TOKEN_PARAGRAPH);
-
-      char* token = malloc(length * sizeof(char*));
-      memcpy(token, scanner.start, length - 1);
-      token[length - 1] = '\0';
-      //   printf("%s\n", token);
-
-      Token output = makeToken(TOKEN_IDENTIFIER);
-
-      switch (token[0]) {
-        case 'b': {
-          if (strcmp(token, "body") == 0) {
-            output = makeToken(TOKEN_BODY);
-          }
-          break;
-        }
-        case 'c': {
-          // structurally correct but became messy, probably could be cleaned
-          // up.
-          if (length > 1) {
-            switch (token[1]) {
-              case 'o':
-                if (length > 2) {
-                  switch (token[2]) {
-                    case 'n':
-                      if (length > 3) {
-                        if (length == 4)
-                          output = makeToken(TOKEN_CONTAINER);
-                        else {
-                          switch (token[3]) {
-                            case 't':
-                              if (length > 4) {
-                                switch (token[4]) {
-                                  case 'a':
-                                    if (strcmp(token, "container") == 0) {
-                                      output = makeToken(TOKEN_CONTAINER);
-                                    }
-                                    break;
-                                  case 'e':
-                                    if (strcmp(token, "content") == 0) {
-                                      output = makeToken(TOKEN_BODY);
-                                    }
-                                    break;
-                                }
-                              }
-                              break;
-                          }
-                        }
-                      }
-                      break;
-                  }
-                }
-                break;
-              case 's':
-                if (strcmp(token, "css") == 0) {
-                  output = makeToken(TOKEN_CSS);
-                }
-                break;
-            }
-          }
-          break;
-        }
-        case 'd': {
-          if (length > 1) {
-            switch (token[1]) {
-              case 'o':
-                if (strcmp(token, "document") == 0) {
-                  output = makeToken(TOKEN_DOCUMENT);
-                }
-                break;
-              case 'i':
-                if (strcmp(token, "div") == 0) {
-                  output = makeToken(TOKEN_CONTAINER);
-                }
-                break;
-              case 'a':
-                if (strcmp(token, "data") == 0) {
-                  output = makeToken(TOKEN_HEAD);
-                }
-                break;
-            }
-          }
-          break;
-        }
-        case 'h': {
-          if (length > 1) {
-            switch (token[1]) {
-              case '1': {
-                output = makeToken(TOKEN_HEADING1);
-                break;
-              }
-              case '2': {
-                output = makeToken(TOKEN_HEADING2);
-                break;
-              }
-              case '3': {
-                output = makeToken(TOKEN_HEADING3);
-                break;
-              }
-              case '4': {
-                output = makeToken(TOKEN_HEADING4);
-                break;
-              }
-              case '5': {
-                output = makeToken(TOKEN_HEADING5);
-                break;
-              }
-              case '6': {
-                output = makeToken(TOKEN_HEADING6);
-                break;
-              }
-              case 'e':
-                if (strcmp(token, "head") == 0) {
-                  output = makeToken(TOKEN_HEAD);
-                }
-                break;
-            }
-          }
-          break;
-        }
-        case 't': {
-          if (strcmp(token, "title") == 0) {
-            output = makeToken(TOKEN_TITLE);
-          }
-          break;
-        }
-        default:
-          break;
-      }
-
-      free(token);
+      Token output = makeToken(scanner, TOKEN_IDENTIFIER);
+      output.type = keywordType(output.start, output.length);
 
-      scanner.start = scanner.current;
+      scanner->start = scanner->current;
 
       return output;
     }
@@ -408,82 +650,71 @@ Token scanToken() {
 }
 
 /**
- * @brief Prints a token formattted nicely.
+ * @brief Names a token type, for debugging output and token dumps.
  *
- * @param token the token to print.
+ * @param type the type to name.
+ * @return const char* the name.
  */
-void printToken(Token token) {
-  switch (token.type) {
+const char* tokenTypeName(TokenType type) {
+  switch (type) {
     case TOKEN_EOF:
-      printf("EOF (");
-      break;
+      return "EOF";
     case TOKEN_ERROR:
-      printf("ERROR (");
-      break;
+      return "ERROR";
+    case TOKEN_COMMENT:
+      return "COMMENT";
     case TOKEN_DOCUMENT:
-      printf("DOCUMENT (");
-      break;
+      return "DOCUMENT";
     case TOKEN_HEAD:
-      printf("HEAD (");
-      break;
+      return "HEAD";
     case TOKEN_TITLE:
-      printf("TITLE (");
-      break;
+      return "TITLE";
     case TOKEN_CONTAINER:
-      printf("CONTAINER (");
-      break;
+      return "CONTAINER";
     case TOKEN_BODY:
-      printf("BODY (");
-      break;
+      return "BODY";
     case TOKEN_HEADING1:
-      printf("HEADING1 (");
-      break;
+      return "HEADING1";
     case TOKEN_HEADING2:
-      printf("HEADING2 (");
-      break;
+      return "HEADING2";
     case TOKEN_HEADING3:
-      printf("HEADING3 (");
-      break;
+      return "HEADING3";
     case TOKEN_HEADING4:
-      printf("HEADING4 (");
-      break;
+      return "HEADING4";
     case TOKEN_HEADING5:
-      printf("HEADING5 (");
-      break;
+      return "HEADING5";
     case TOKEN_HEADING6:
-      printf("HEADING6 (");
-      break;
+      return "HEADING6";
     case TOKEN_PARAGRAPH:
-      printf("PARAGRAPH (");
-      break;
+      return "PARAGRAPH";
     case TOKEN_TEXT:
-      printf("TEXT (");
-      break;
+      return "TEXT";
     case TOKEN_RAW_HTML:
-      printf("RAW_HTML (");
-      break;
+      return "RAW_HTML";
     case TOKEN_CSS:
-      printf("CSS (");
-      break;
+      return "CSS";
     case TOKEN_LEFT_PAREN:
-      printf("LEFT_PAREN (");
-      break;
+      return "LEFT_PAREN";
     case TOKEN_RIGHT_PAREN:
-      printf("RIGHT_PAREN (");
-      break;
+      return "RIGHT_PAREN";
     case TOKEN_EXCLAMATION:
-      printf("EXCLAMATION (");
-      break;
+      return "EXCLAMATION";
     case TOKEN_MACRO:
-      printf("MACRO (");
-      break;
+      return "MACRO";
     case TOKEN_IDENTIFIER:
-      printf("IDENTIFIER (");
-      break;
+      return "IDENTIFIER";
     default:
-      printf("UNKNOWN (");
-      break;
+      return "UNKNOWN";
   }
-  printf("%d, %d, %d, %d, %s)\n", token.line, token.col, token.tab,
-         token.length, token.start);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Prints a token formattted nicely.
+ *
+ * @param token the token to print.
+ */
+void printToken(Token token) {
+  printf("%s (", tokenTypeName(token.type));
+  printf("%d, %d, %d, %d, %.*s)\n", token.line, token.col, token.tab,
+         token.length, token.length, token.start);
+}
@@ -9,6 +9,12 @@
 #ifndef CHTML_SCANNER_H
 #define CHTML_SCANNER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
 typedef enum {
   TOKEN_EOF,
   TOKEN_ERROR,
@@ -33,6 +39,8 @@ typedef enum {
   TOKEN_EXCLAMATION,
   TOKEN_MACRO,
   TOKEN_IDENTIFIER,
+  // not a token, the number of token types
+  TOKEN_TYPE_COUNT,
 } TokenType;
 
 typedef struct {
@@ -40,22 +48,86 @@ typedef struct {
   int col;
   int line;
   int tab;
-  char* start;
+  const char* start;
   int length;
 } Token;
 
+// bytes read from a stream each time the scanner refills
+#define SCANNER_CHUNK 65536
+// maximum number of macro expansions open at once (macros calling macros)
+#define MAX_EXPANSION_DEPTH 64
+
+// a token of a macro body, positioned relative to the body's first line
+typedef struct {
+  uint8_t type;
+  uint32_t tab;
+  uint32_t line;
+  uint32_t start;
+  uint32_t length;
+} MacroToken;
+
+// a macro body, tokenized once when it is defined and replayed on each call
+typedef struct Macro {
+  char* name;
+  char* text;
+  MacroToken* tokens;
+  int count;
+  int capacity;
+} Macro;
+
+// a macro call being replayed, tokens are placed at the call site
+typedef struct {
+  const Macro* macro;
+  int next;
+  int line;
+  int col;
+  int tab;
+} Expansion;
+
 typedef struct {
-  char* start;
-  char* current;
+  // the in-memory source, NULL when streaming
+  const char* source;
+  const char* start;
+  const char* current;
+  const char* end;
+  const char* mark;
   int line;
   int col;
   int tabs;
+  // streaming input, fd is -1 when scanning an in-memory source
+  int fd;
+  bool exhausted;
+  char* buffer;
+  size_t capacity;
+  char** retired;
+  int retiredCount;
+  int retiredCapacity;
+  // set when a streamed source fails to read
+  const char* error;
+  // where definitions are allocated, owned by whoever set up the scanner
+  Arena* arena;
+  // definitions from @name blocks in the order they were made, allocated
+  // from the arena, the compiler defines them as it reaches their TOKEN_MACRO
+  Macro** defined;
+  int definedCount;
+  int definedCapacity;
+  // vectorized loops for this CPU
+  const struct ScanKernels* kernels;
+  Expansion expansions[MAX_EXPANSION_DEPTH];
+  int expansionCount;
 } Scanner;
 
-void initScanner(char* source);
-void insertMacro(int tabs, char* source);
-Token scanToken();
+void initScanner(Scanner* scanner,
+                 const char* source,
+                 size_t length,
+                 Arena* arena);
+void initStreamScanner(Scanner* scanner, int fd, Arena* arena);
+void freeScanner(Scanner* scanner);
+Macro* newMacro(Arena* arena, const char* text);
+bool expandMacro(Scanner* scanner, const Macro* macro, Token call);
+bool expansionToken(Scanner* scanner, Token* token);
+Token scanToken(Scanner* scanner);
+const char* tokenTypeName(TokenType type);
 void printToken(Token token);
-char peek();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,450 @@
+/**
+ * @file server.c
+ * @author Devin Arena
+ * @brief A resident compile daemon listening on a Unix domain socket, and the
+ * matching client. Keeping the process warm skips process startup, loading
+ * and context setup for every page.
+ *
+ * Every message is a frame: a one byte type, a four byte big-endian length
+ * and that many bytes of payload.
+ *
+ *   client -> server  'S' source text to compile
+ *                     'P' path of a source file the server should read
+ *   server -> client  'D' a chunk of HTML, repeated as it is produced
+ *                     'O' compile finished (empty payload)
+ *                     'E' compile failed, payload is the message
+ *
+ * A connection may send any number of requests one after another.
+ * @since 11/20/2022
+ **/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "builder.h"
+#include "chtml.h"
+#include "server.h"
+#include "source.h"
+
+// largest request the server will accept
+#define MAX_REQUEST (256u * 1024 * 1024)
+
+// idle contexts kept warm for the next request
+static ChtmlContext** idleContexts = NULL;
+static int idleCount = 0;
+static int idleCapacity = 0;
+static pthread_mutex_t idleLock = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ * @brief Reads exactly length bytes from a descriptor.
+ *
+ * @return bool false on error or end of stream.
+ */
+static bool readFull(int fd, void* buffer, size_t length) {
+  char* chars = buffer;
+  while (length > 0) {
+    ssize_t count = read(fd, chars, length);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0)
+      return false;
+    chars += count;
+    length -= count;
+  }
+  return true;
+}
+
+/**
+ * @brief Writes exactly length bytes to a descriptor.
+ *
+ * @return bool false on error.
+ */
+static bool writeFull(int fd, const void* buffer, size_t length) {
+  const char* chars = buffer;
+  while (length > 0) {
+    ssize_t count = write(fd, chars, length);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0)
+      return false;
+    chars += count;
+    length -= count;
+  }
+  return true;
+}
+
+/**
+ * @brief Sends one frame.
+ *
+ * @param fd int the socket to write to.
+ * @param type char the frame type.
+ * @param payload const char* the payload, may be NULL if length is 0.
+ * @param length size_t the payload length, at most UINT32_MAX.
+ * @return bool false on error, or if the length does not fit the header.
+ */
+static bool writeFrame(int fd, char type, const char* payload, size_t length) {
+  if (length > UINT32_MAX) {
+    errno = EMSGSIZE;
+    return false;
+  }
+
+  unsigned char header[5] = {type, length >> 24, length >> 16, length >> 8,
+                             length};
+  return writeFull(fd, header, sizeof(header)) &&
+         (length == 0 || writeFull(fd, payload, length));
+}
+
+/**
+ * @brief Reads a frame header.
+ *
+ * @param fd int the socket to read from.
+ * @param type char* set to the frame type.
+ * @param length uint32_t* set to the payload length.
+ * @return bool false on error or end of stream.
+ */
+static bool readHeader(int fd, char* type, uint32_t* length) {
+  unsigned char header[5];
+  if (!readFull(fd, header, sizeof(header)))
+    return false;
+
+  *type = header[0];
+  *length = (uint32_t)header[1] << 24 | (uint32_t)header[2] << 16 |
+            (uint32_t)header[3] << 8 | header[4];
+  return true;
+}
+
+/**
+ * @brief Sink callback sending each flushed block of HTML as 'D' frames,
+ * split where a block is too long for one.
+ */
+static bool writeDataFrame(void* userData, const char* chars, size_t length) {
+  do {
+    size_t count = length > UINT32_MAX ? UINT32_MAX : length;
+    if (!writeFrame(*(int*)userData, 'D', chars, count))
+      return false;
+    chars += count;
+    length -= count;
+  } while (length > 0);
+  return true;
+}
+
+/**
+ * @brief Takes a warm context from the idle list, or creates one.
+ *
+ * @return ChtmlContext* the context.
+ */
+static ChtmlContext* acquireContext() {
+  pthread_mutex_lock(&idleLock);
+  ChtmlContext* context = idleCount > 0 ? idleContexts[--idleCount] : NULL;
+  pthread_mutex_unlock(&idleLock);
+
+  return context != NULL ? context : chtmlCreate();
+}
+
+/**
+ * @brief Returns a context to the idle list for the next request.
+ *
+ * @param context ChtmlContext* the context to return.
+ */
+static void releaseContext(ChtmlContext* context) {
+  pthread_mutex_lock(&idleLock);
+  if (idleCount == idleCapacity) {
+    idleCapacity = idleCapacity < 8 ? 8 : idleCapacity * 2;
+    idleContexts = realloc(idleContexts, sizeof(ChtmlContext*) * idleCapacity);
+  }
+  idleContexts[idleCount++] = context;
+  pthread_mutex_unlock(&idleLock);
+}
+
+/**
+ * @brief Compiles one request and streams the response.
+ *
+ * @param fd int the client socket.
+ * @param type char 'S' or 'P'.
+ * @param payload const char* the source or the NUL terminated path.
+ * @param length uint32_t the payload length.
+ * @return bool false if the connection should be dropped.
+ */
+static bool handleRequest(int fd, char type, const char* payload,
+                          uint32_t length) {
+  ChtmlContext* context = acquireContext();
+
+  Source source = {0};
+  bool loaded = true;
+  if (type == 'P') {
+    loaded = openSource(&source, payload);
+  } else {
+    source.chars = payload;
+    source.length = length;
+  }
+
+  bool ok;
+  if (!loaded) {
+    char message[512];
+    int count = snprintf(message, sizeof(message), "Could not read file '%s': %s",
+                         payload, strerror(errno));
+    ok = writeFrame(fd, 'E', message, count);
+  } else {
+    Sink output;
+    initCallbackSink(&output, writeDataFrame, &fd);
+    if (chtmlCompile(context, source.chars, source.length, &output)) {
+      ok = writeFrame(fd, 'O', NULL, 0);
+    } else {
+      const char* error = chtmlError(context);
+      ok = !output.failed && writeFrame(fd, 'E', error, strlen(error));
+    }
+    if (type == 'P')
+      closeSource(&source);
+  }
+
+  releaseContext(context);
+  return ok;
+}
+
+/**
+ * @brief Connection thread, serves requests until the client hangs up.
+ *
+ * @param arg void* the client socket, stored in the pointer.
+ * @return void* always NULL.
+ */
+static void* handleClient(void* arg) {
+  int fd = (int)(intptr_t)arg;
+  char* payload = NULL;
+
+  while (true) {
+    char type;
+    uint32_t length;
+    if (!readHeader(fd, &type, &length))
+      break;
+
+    if ((type != 'S' && type != 'P') || length > MAX_REQUEST) {
+      const char* message = "Malformed request";
+      writeFrame(fd, 'E', message, strlen(message));
+      break;
+    }
+
+    // + 1 so paths can be NUL terminated
+    payload = realloc(payload, length + 1);
+    if (payload == NULL || !readFull(fd, payload, length))
+      break;
+    payload[length] = '\0';
+
+    if (!handleRequest(fd, type, payload, length))
+      break;
+  }
+
+  free(payload);
+  close(fd);
+  return NULL;
+}
+
+/**
+ * @brief Signal handler asking the accept loop to stop.
+ */
+static void requestStop(int signal) {
+  (void)signal;
+  stopping = 1;
+}
+
+/**
+ * @brief Fills in a socket address for a path.
+ *
+ * @return bool false if the path is too long.
+ */
+static bool makeAddress(struct sockaddr_un* address, const char* path) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address->sun_path)) {
+    fprintf(stderr, "Socket path '%s' is too long\n", path);
+    return false;
+  }
+  strcpy(address->sun_path, path);
+  return true;
+}
+
+/**
+ * @brief Listens on a Unix socket and compiles requests until interrupted.
+ * Each client gets its own thread, compile contexts are reused between
+ * requests.
+ *
+ * @param socketPath const char* the path to bind the socket to.
+ * @return int the process exit code.
+ */
+int serve(const char* socketPath) {
+  struct sockaddr_un address;
+  if (!makeAddress(&address, socketPath))
+    return 1;
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    fprintf(stderr, "Could not create socket: %s\n", strerror(errno));
+    return 1;
+  }
+
+  // a stale socket from a previous run would make bind fail
+  unlink(socketPath);
+  if (bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(server, 64) != 0) {
+    fprintf(stderr, "Could not listen on '%s': %s\n", socketPath,
+            strerror(errno));
+    close(server);
+    return 1;
+  }
+
+  // clients hanging up mid response must not kill the daemon
+  signal(SIGPIPE, SIG_IGN);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  // warm one context so the first request skips setup
+  releaseContext(chtmlCreate());
+
+  printf("Listening on %s\n", socketPath);
+  fflush(stdout);
+
+  while (!stopping) {
+    int client = accept(server, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "Could not accept connection: %s\n", strerror(errno));
+      break;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, handleClient,
+                       (void*)(intptr_t)client) != 0) {
+      close(client);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  close(server);
+  unlink(socketPath);
+  return 0;
+}
+
+/**
+ * @brief Sends a compile request to a running daemon and writes the HTML,
+ * a drop-in replacement for compiling in process.
+ *
+ * @param socketPath const char* the daemon's socket.
+ * @param inputName const char* the source file, "-" sends stdin.
+ * @param outputName const char* the output file, "-" writes to stdout.
+ * @return int the process exit code.
+ */
+int runClient(const char* socketPath,
+              const char* inputName,
+              const char* outputName) {
+  struct sockaddr_un address;
+  if (!makeAddress(&address, socketPath))
+    return 1;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+    fprintf(stderr, "Could not connect to '%s': %s\n", socketPath,
+            strerror(errno));
+    return 74;
+  }
+
+  bool sent;
+  if (strcmp(inputName, "-") == 0) {
+    Source source;
+    if (!openSource(&source, inputName)) {
+      fprintf(stderr, "Could not read stdin: %s\n", strerror(errno));
+      return 74;
+    }
+    // a source has to fit in one frame
+    if (source.length > UINT32_MAX) {
+      fprintf(stderr, "Could not send stdin: %s\n", strerror(EMSGSIZE));
+      closeSource(&source);
+      close(fd);
+      return 74;
+    }
+    sent = writeFrame(fd, 'S', source.chars, source.length);
+    closeSource(&source);
+  } else {
+    // the daemon may run in another directory
+    char* path = realpath(inputName, NULL);
+    if (path == NULL) {
+      fprintf(stderr, "Could not read file '%s': %s\n", inputName,
+              strerror(errno));
+      return 74;
+    }
+    sent = writeFrame(fd, 'P', path, strlen(path));
+    free(path);
+  }
+
+  // buffered so a failed compile never leaves a partial document
+  StringBuilder html;
+  initBuilder(&html);
+  int status = 74;
+
+  while (sent) {
+    char type;
+    uint32_t length;
+    if (!readHeader(fd, &type, &length))
+      break;
+
+    char* payload = malloc(length + 1);
+    if (payload == NULL || !readFull(fd, payload, length)) {
+      free(payload);
+      break;
+    }
+    payload[length] = '\0';
+
+    if (type == 'D') {
+      builderAppend(&html, payload, length);
+      free(payload);
+      continue;
+    }
+
+    if (type == 'E') {
+      fprintf(stderr, "Compile error: %s\n", payload);
+      status = 1;
+    } else if (type == 'O') {
+      status = 0;
+    }
+    free(payload);
+    break;
+  }
+  close(fd);
+
+  if (status == 74)
+    fprintf(stderr, "Lost connection to '%s'\n", socketPath);
+
+  if (status == 0) {
+    Sink output;
+    if (strcmp(outputName, "-") == 0) {
+      initFdSink(&output, STDOUT_FILENO);
+    } else if (!openFileSink(&output, outputName)) {
+      fprintf(stderr, "Could not open output file '%s'\n", outputName);
+      freeBuilder(&html);
+      return 74;
+    }
+    sinkWrite(&output, html.chars, html.length);
+    if (!closeSink(&output)) {
+      fprintf(stderr, "Could not write output '%s'\n", outputName);
+      status = 74;
+    }
+  }
+
+  freeBuilder(&html);
+  return status;
+}
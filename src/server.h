@@ -0,0 +1,16 @@
+/**
+ * @file server.h
+ * @author Devin Arena
+ * @brief Header for the resident compile daemon and its client.
+ * @since 11/20/2022
+ **/
+
+#ifndef CHTML_SERVER_H
+#define CHTML_SERVER_H
+
+int serve(const char* socketPath);
+int runClient(const char* socketPath,
+              const char* inputName,
+              const char* outputName);
+
+#endif
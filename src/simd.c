@@ -0,0 +1,375 @@
+/**
+ * @file simd.c
+ * @author Devin Arena
+ * @brief SSE2 and AVX2 kernels for the scanner's and emitter's hot loops,
+ * compared 16 or 32 bytes at a time. The widest set the CPU supports is
+ * picked at runtime, CHTML_SIMD=scalar|sse2|avx2 overrides the choice (for
+ * testing).
+ * @since 11/27/2022
+ **/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+static const char* scalarSkipBlank(const char* current, const char* end) {
+  while (current < end && (*current == ' ' || *current == '\t' ||
+                           *current == '\r' || *current == '\n'))
+    current++;
+  return current;
+}
+
+static const char* scalarSkipTabs(const char* current, const char* end) {
+  while (current < end && (*current == '\t' || *current == '\r'))
+    current++;
+  return current;
+}
+
+static int scalarCountNewlines(const char* current, const char* end,
+                               const char** last) {
+  int count = 0;
+  for (; current < end; current++) {
+    if (*current == '\n') {
+      *last = current;
+      count++;
+    }
+  }
+  return count;
+}
+
+static const char* scalarFindQuote(const char* current, const char* end,
+                                   char quote, int* newlines,
+                                   const char** last) {
+  *newlines = 0;
+  for (; current < end && *current != quote; current++) {
+    if (*current == '\n') {
+      *last = current;
+      (*newlines)++;
+    }
+  }
+  return current;
+}
+
+static const char* scalarFindTextEscape(const char* current,
+                                        const char* end) {
+  while (current < end && *current != '&' && *current != '<' &&
+         *current != '>')
+    current++;
+  return current;
+}
+
+static const char* scalarFindAttributeEscape(const char* current,
+                                             const char* end) {
+  while (current < end && *current != '&' && *current != '<' &&
+         *current != '>' && *current != '"' && *current != '\'')
+    current++;
+  return current;
+}
+
+static const ScanKernels scalarKernels = {
+    "scalar", scalarSkipBlank, scalarSkipTabs, scalarCountNewlines,
+    scalarFindQuote, scalarFindTextEscape, scalarFindAttributeEscape,
+};
+
+#ifdef SIMD_X86
+
+// the SSE2 kernels finish the AVX2 ones' tails, inlining them there keeps the
+// whole kernel VEX encoded and avoids SSE/AVX transition stalls
+#define SSE2_KERNEL static inline __attribute__((always_inline))
+
+SSE2_KERNEL const char* sse2SkipBlank(const char* current,
+                                      const char* end) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i ret = _mm_set1_epi8('\r');
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  for (; current + 16 <= end; current += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)current);
+    __m128i blank = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(block, ret),
+                     _mm_cmpeq_epi8(block, newline)));
+    unsigned mask = ~_mm_movemask_epi8(blank) & 0xffff;
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return scalarSkipBlank(current, end);
+}
+
+SSE2_KERNEL const char* sse2SkipTabs(const char* current,
+                                     const char* end) {
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i ret = _mm_set1_epi8('\r');
+
+  for (; current + 16 <= end; current += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)current);
+    __m128i tabs =
+        _mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, ret));
+    unsigned mask = ~_mm_movemask_epi8(tabs) & 0xffff;
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return scalarSkipTabs(current, end);
+}
+
+SSE2_KERNEL int sse2CountNewlines(const char* current, const char* end,
+                                  const char** last) {
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  int count = 0;
+  for (; current + 16 <= end; current += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)current);
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+    if (mask != 0) {
+      *last = current + 31 - __builtin_clz(mask);
+      count += __builtin_popcount(mask);
+    }
+  }
+  return count + scalarCountNewlines(current, end, last);
+}
+
+SSE2_KERNEL const char* sse2FindQuote(const char* current, const char* end,
+                                      char quote, int* newlines,
+                                      const char** last) {
+  const __m128i quotes = _mm_set1_epi8(quote);
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  int count = 0;
+  for (; current + 16 <= end; current += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)current);
+    unsigned found = _mm_movemask_epi8(_mm_cmpeq_epi8(block, quotes));
+    unsigned lines = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+    // only newlines before the quote belong to the string
+    if (found != 0)
+      lines &= (1u << __builtin_ctz(found)) - 1;
+    if (lines != 0) {
+      *last = current + 31 - __builtin_clz(lines);
+      count += __builtin_popcount(lines);
+    }
+    if (found != 0) {
+      *newlines = count;
+      return current + __builtin_ctz(found);
+    }
+  }
+
+  const char* stop = scalarFindQuote(current, end, quote, newlines, last);
+  *newlines += count;
+  return stop;
+}
+
+// '<' (0x3c) and '>' (0x3e) differ only in bit 1, '&' (0x26) and '\''
+// (0x27) only in bit 0, so setting that bit tests for both in one compare
+SSE2_KERNEL const char* sse2FindTextEscape(const char* current,
+                                           const char* end) {
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i angle = _mm_set1_epi8('>');
+  const __m128i bit1 = _mm_set1_epi8(2);
+
+  for (; current + 16 <= end; current += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)current);
+    __m128i special =
+        _mm_or_si128(_mm_cmpeq_epi8(block, amp),
+                     _mm_cmpeq_epi8(_mm_or_si128(block, bit1), angle));
+    unsigned mask = _mm_movemask_epi8(special);
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return scalarFindTextEscape(current, end);
+}
+
+SSE2_KERNEL const char* sse2FindAttributeEscape(const char* current,
+                                                const char* end) {
+  const __m128i apostrophe = _mm_set1_epi8('\'');
+  const __m128i angle = _mm_set1_epi8('>');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bit0 = _mm_set1_epi8(1);
+  const __m128i bit1 = _mm_set1_epi8(2);
+
+  for (; current + 16 <= end; current += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)current);
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(_mm_or_si128(block, bit0), apostrophe),
+                     _mm_cmpeq_epi8(_mm_or_si128(block, bit1), angle)),
+        _mm_cmpeq_epi8(block, quote));
+    unsigned mask = _mm_movemask_epi8(special);
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return scalarFindAttributeEscape(current, end);
+}
+
+static const ScanKernels sse2Kernels = {
+    "sse2", sse2SkipBlank, sse2SkipTabs, sse2CountNewlines, sse2FindQuote,
+    sse2FindTextEscape, sse2FindAttributeEscape,
+};
+
+__attribute__((target("avx2"))) static const char* avx2SkipBlank(
+    const char* current, const char* end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i ret = _mm256_set1_epi8('\r');
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  for (; current + 32 <= end; current += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)current);
+    __m256i blank = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+                        _mm256_cmpeq_epi8(block, tab)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, ret),
+                        _mm256_cmpeq_epi8(block, newline)));
+    unsigned mask = ~(unsigned)_mm256_movemask_epi8(blank);
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return sse2SkipBlank(current, end);
+}
+
+__attribute__((target("avx2"))) static const char* avx2SkipTabs(
+    const char* current, const char* end) {
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i ret = _mm256_set1_epi8('\r');
+
+  for (; current + 32 <= end; current += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)current);
+    __m256i tabs = _mm256_or_si256(_mm256_cmpeq_epi8(block, tab),
+                                   _mm256_cmpeq_epi8(block, ret));
+    unsigned mask = ~(unsigned)_mm256_movemask_epi8(tabs);
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return sse2SkipTabs(current, end);
+}
+
+__attribute__((target("avx2"))) static int avx2CountNewlines(
+    const char* current, const char* end, const char** last) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  int count = 0;
+  for (; current + 32 <= end; current += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)current);
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+    if (mask != 0) {
+      *last = current + 31 - __builtin_clz(mask);
+      count += __builtin_popcount(mask);
+    }
+  }
+  return count + sse2CountNewlines(current, end, last);
+}
+
+__attribute__((target("avx2"))) static const char* avx2FindQuote(
+    const char* current, const char* end, char quote, int* newlines,
+    const char** last) {
+  const __m256i quotes = _mm256_set1_epi8(quote);
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  int count = 0;
+  for (; current + 32 <= end; current += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)current);
+    unsigned found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, quotes));
+    unsigned lines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+    if (found != 0)
+      lines &= (found & -found) - 1;
+    if (lines != 0) {
+      *last = current + 31 - __builtin_clz(lines);
+      count += __builtin_popcount(lines);
+    }
+    if (found != 0) {
+      *newlines = count;
+      return current + __builtin_ctz(found);
+    }
+  }
+
+  const char* stop = sse2FindQuote(current, end, quote, newlines, last);
+  *newlines += count;
+  return stop;
+}
+
+__attribute__((target("avx2"))) static const char* avx2FindTextEscape(
+    const char* current, const char* end) {
+  const __m256i amp = _mm256_set1_epi8('&');
+  const __m256i angle = _mm256_set1_epi8('>');
+  const __m256i bit1 = _mm256_set1_epi8(2);
+
+  for (; current + 32 <= end; current += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)current);
+    __m256i special = _mm256_or_si256(
+        _mm256_cmpeq_epi8(block, amp),
+        _mm256_cmpeq_epi8(_mm256_or_si256(block, bit1), angle));
+    unsigned mask = _mm256_movemask_epi8(special);
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return sse2FindTextEscape(current, end);
+}
+
+__attribute__((target("avx2"))) static const char* avx2FindAttributeEscape(
+    const char* current, const char* end) {
+  const __m256i apostrophe = _mm256_set1_epi8('\'');
+  const __m256i angle = _mm256_set1_epi8('>');
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i bit0 = _mm256_set1_epi8(1);
+  const __m256i bit1 = _mm256_set1_epi8(2);
+
+  for (; current + 32 <= end; current += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)current);
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_cmpeq_epi8(_mm256_or_si256(block, bit0), apostrophe),
+            _mm256_cmpeq_epi8(_mm256_or_si256(block, bit1), angle)),
+        _mm256_cmpeq_epi8(block, quote));
+    unsigned mask = _mm256_movemask_epi8(special);
+    if (mask != 0)
+      return current + __builtin_ctz(mask);
+  }
+  return sse2FindAttributeEscape(current, end);
+}
+
+static const ScanKernels avx2Kernels = {
+    "avx2", avx2SkipBlank, avx2SkipTabs, avx2CountNewlines, avx2FindQuote,
+    avx2FindTextEscape, avx2FindAttributeEscape,
+};
+
+#endif
+
+static const ScanKernels* selected = &scalarKernels;
+static pthread_once_t selectOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Picks the widest kernels the CPU runs, or the ones CHTML_SIMD names.
+ */
+static void selectKernels() {
+  const char* forced = getenv("CHTML_SIMD");
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2");
+
+  if (forced != NULL && strcmp(forced, "scalar") == 0)
+    selected = &scalarKernels;
+  else if (forced != NULL && strcmp(forced, "sse2") == 0)
+    selected = &sse2Kernels;
+  else
+    selected = avx2 ? &avx2Kernels : &sse2Kernels;
+#else
+  (void)forced;
+  selected = &scalarKernels;
+#endif
+}
+
+/**
+ * @brief Returns the kernels for this CPU, selected once per process.
+ *
+ * @return const ScanKernels* the kernels.
+ */
+const ScanKernels* scanKernels() {
+  pthread_once(&selectOnce, selectKernels);
+  return selected;
+}
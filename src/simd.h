@@ -0,0 +1,35 @@
+/**
+ * @file simd.h
+ * @author Devin Arena
+ * @brief Header for the vectorized scanning kernels.
+ * @since 11/27/2022
+ **/
+
+#ifndef CHTML_SIMD_H
+#define CHTML_SIMD_H
+
+#include <stddef.h>
+
+// the kernels the scanner runs over whitespace, indentation and quoted text,
+// and the emitter runs over text it escapes, every implementation returns
+// exactly what the scalar one does
+typedef struct ScanKernels {
+  const char* name;
+  // first byte that is not ' ', '\t', '\r' or '\n'
+  const char* (*skipBlank)(const char* current, const char* end);
+  // first byte that is not '\t' or '\r' (both count as indentation)
+  const char* (*skipTabs)(const char* current, const char* end);
+  // number of '\n' bytes, last is set to the final one when there are any
+  int (*countNewlines)(const char* current, const char* end, const char** last);
+  // first quote byte, counting the newlines before it like countNewlines
+  const char* (*findQuote)(const char* current, const char* end, char quote,
+                           int* newlines, const char** last);
+  // first '&', '<' or '>', the bytes text content escapes
+  const char* (*findTextEscape)(const char* current, const char* end);
+  // first '&', '<', '>', '"' or '\'', the bytes attribute values escape
+  const char* (*findAttributeEscape)(const char* current, const char* end);
+} ScanKernels;
+
+const ScanKernels* scanKernels();
+
+#endif
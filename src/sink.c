@@ -0,0 +1,227 @@
+/**
+ * @file sink.c
+ * @author Devin Arena
+ * @brief Buffered output sinks. The compiler streams HTML through a fixed size
+ * buffer into a file, file descriptor, string builder, or user callback so
+ * memory use does not grow with the size of the document.
+ * @since 11/13/2022
+ **/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gzip.h"
+#include "sink.h"
+
+/**
+ * @brief Sets up the fields shared by every sink type.
+ *
+ * @param sink Sink* the sink to initialize.
+ * @param type SinkType the destination type.
+ */
+static void initSink(Sink* sink, SinkType type) {
+  sink->type = type;
+  sink->gzip = NULL;
+  sink->owned = false;
+  sink->failed = false;
+  sink->written = 0;
+  sink->length = 0;
+}
+
+/**
+ * @brief Opens a file for writing and initializes a sink that owns it.
+ *
+ * @param sink Sink* the sink to initialize.
+ * @param path const char* the path of the file to write.
+ * @return bool false if the file could not be opened.
+ */
+bool openFileSink(Sink* sink, const char* path) {
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+    return false;
+
+  initFileSink(sink, file);
+  sink->owned = true;
+  return true;
+}
+
+/**
+ * @brief Initializes a sink writing to an already open stdio stream.
+ *
+ * @param sink Sink* the sink to initialize.
+ * @param file FILE* the stream to write to, not closed by the sink.
+ */
+void initFileSink(Sink* sink, FILE* file) {
+  initSink(sink, SINK_FILE);
+  sink->as.file = file;
+}
+
+/**
+ * @brief Initializes a sink writing to a raw file descriptor (stdout, a pipe
+ * or a socket).
+ *
+ * @param sink Sink* the sink to initialize.
+ * @param fd int the descriptor to write to, not closed by the sink.
+ */
+void initFdSink(Sink* sink, int fd) {
+  initSink(sink, SINK_FD);
+  sink->as.fd = fd;
+}
+
+/**
+ * @brief Initializes a sink that collects output in a string builder.
+ *
+ * @param sink Sink* the sink to initialize.
+ * @param builder StringBuilder* the builder to append to.
+ */
+void initMemorySink(Sink* sink, StringBuilder* builder) {
+  initSink(sink, SINK_MEMORY);
+  sink->as.builder = builder;
+}
+
+/**
+ * @brief Initializes a sink that hands each flushed block to a callback.
+ *
+ * @param sink Sink* the sink to initialize.
+ * @param write SinkWriteFn the callback, returns false on failure.
+ * @param userData void* passed through to the callback.
+ */
+void initCallbackSink(Sink* sink, SinkWriteFn write, void* userData) {
+  initSink(sink, SINK_CALLBACK);
+  sink->as.callback.write = write;
+  sink->as.callback.userData = userData;
+}
+
+/**
+ * @brief Writes all of the given characters to a file descriptor, retrying
+ * short writes.
+ *
+ * @param fd int the descriptor to write to.
+ * @param chars const char* the characters to write.
+ * @param length size_t the number of characters to write.
+ * @return bool false if the write failed.
+ */
+static bool writeFd(int fd, const char* chars, size_t length) {
+  while (length > 0) {
+    ssize_t count = write(fd, chars, length);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    chars += count;
+    length -= count;
+  }
+  return true;
+}
+
+/**
+ * @brief Sends characters straight to the sink's destination.
+ *
+ * @param sink Sink* the sink to write through.
+ * @param chars const char* the characters to write.
+ * @param length size_t the number of characters to write.
+ */
+static void writeThrough(Sink* sink, const char* chars, size_t length) {
+  if (sink->failed || length == 0)
+    return;
+
+  bool ok = true;
+  switch (sink->type) {
+    case SINK_FILE:
+      ok = fwrite(chars, sizeof(char), length, sink->as.file) == length;
+      break;
+    case SINK_FD:
+      ok = writeFd(sink->as.fd, chars, length);
+      break;
+    case SINK_MEMORY:
+      builderAppend(sink->as.builder, chars, length);
+      break;
+    case SINK_CALLBACK:
+      ok = sink->as.callback.write(sink->as.callback.userData, chars, length);
+      break;
+  }
+
+  if (!ok) {
+    sink->failed = true;
+    return;
+  }
+  sink->written += length;
+  // compressed a buffer at a time as it leaves, not once the file is done
+  if (sink->gzip != NULL)
+    gzipWrite(sink->gzip, chars, length);
+}
+
+/**
+ * @brief Tells the sink how much is about to be written. Memory sinks grow
+ * their builder once instead of as the writes arrive, other sinks ignore it.
+ *
+ * @param sink Sink* the sink about to be written to.
+ * @param length size_t the number of characters that will be written.
+ */
+void sinkReserve(Sink* sink, size_t length) {
+  if (sink->type == SINK_MEMORY)
+    builderReserve(sink->as.builder, length);
+}
+
+/**
+ * @brief Writes characters to the sink, buffering them until the buffer is
+ * full. Writes larger than the buffer skip it entirely.
+ *
+ * @param sink Sink* the sink to write to.
+ * @param chars const char* the characters to write.
+ * @param length size_t the number of characters to write.
+ */
+void sinkWrite(Sink* sink, const char* chars, size_t length) {
+  // memory sinks already grow geometrically, buffering would only copy twice
+  if (sink->type == SINK_MEMORY) {
+    writeThrough(sink, chars, length);
+    return;
+  }
+
+  if (sink->length + length > SINK_BUFFER_SIZE) {
+    flushSink(sink);
+    if (length >= SINK_BUFFER_SIZE) {
+      writeThrough(sink, chars, length);
+      return;
+    }
+  }
+
+  memcpy(sink->buffer + sink->length, chars, length);
+  sink->length += length;
+}
+
+/**
+ * @brief Pushes any buffered characters to the sink's destination.
+ *
+ * @param sink Sink* the sink to flush.
+ * @return bool false if any write to the sink has failed.
+ */
+bool flushSink(Sink* sink) {
+  writeThrough(sink, sink->buffer, sink->length);
+  sink->length = 0;
+
+  if (sink->type == SINK_FILE && !sink->failed && fflush(sink->as.file) != 0)
+    sink->failed = true;
+
+  return !sink->failed;
+}
+
+/**
+ * @brief Flushes the sink and closes its file if the sink owns it.
+ *
+ * @param sink Sink* the sink to close.
+ * @return bool false if any write to the sink has failed.
+ */
+bool closeSink(Sink* sink) {
+  flushSink(sink);
+
+  if (sink->type == SINK_FILE && sink->owned) {
+    if (fclose(sink->as.file) != 0)
+      sink->failed = true;
+    sink->owned = false;
+  }
+
+  return !sink->failed;
+}
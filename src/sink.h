@@ -0,0 +1,62 @@
+/**
+ * @file sink.h
+ * @author Devin Arena
+ * @brief Header for output sinks, the destinations compiled HTML is streamed
+ * to.
+ * @since 11/13/2022
+ **/
+
+#ifndef CHTML_SINK_H
+#define CHTML_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "builder.h"
+
+// bytes buffered before a sink flushes to its destination
+#define SINK_BUFFER_SIZE 8192
+
+typedef bool (*SinkWriteFn)(void* userData, const char* chars, size_t length);
+
+typedef enum {
+  SINK_FILE,
+  SINK_FD,
+  SINK_MEMORY,
+  SINK_CALLBACK,
+} SinkType;
+
+struct GzipWriter;
+
+typedef struct {
+  SinkType type;
+  union {
+    FILE* file;
+    int fd;
+    StringBuilder* builder;
+    struct {
+      SinkWriteFn write;
+      void* userData;
+    } callback;
+  } as;
+  // also receives everything written, compressed (NULL for none)
+  struct GzipWriter* gzip;
+  bool owned;
+  bool failed;
+  size_t written;
+  size_t length;
+  char buffer[SINK_BUFFER_SIZE];
+} Sink;
+
+bool openFileSink(Sink* sink, const char* path);
+void initFileSink(Sink* sink, FILE* file);
+void initFdSink(Sink* sink, int fd);
+void initMemorySink(Sink* sink, StringBuilder* builder);
+void initCallbackSink(Sink* sink, SinkWriteFn write, void* userData);
+void sinkReserve(Sink* sink, size_t length);
+void sinkWrite(Sink* sink, const char* chars, size_t length);
+bool flushSink(Sink* sink);
+bool closeSink(Sink* sink);
+
+#endif
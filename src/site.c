@@ -0,0 +1,462 @@
+/**
+ * @file site.c
+ * @author Devin Arena
+ * @brief Compiles every .ch file under a directory into a mirrored output
+ * directory on a work-stealing thread pool. Builds that fingerprint their
+ * stylesheets also write a manifest of the fingerprinted names.
+ * @since 11/18/2022
+ **/
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "builder.h"
+#include "chtml.h"
+#include "path.h"
+#include "pool.h"
+#include "site.h"
+#include "timer.h"
+
+// written to the output root of builds that fingerprint stylesheets
+#define ASSET_MANIFEST_NAME "asset-manifest.json"
+
+typedef struct {
+  Site* site;
+  Page* page;
+} PageTask;
+
+/**
+ * @brief Checks if a file name has the .ch extension.
+ *
+ * @param name const char* the file name.
+ * @return bool true for CHTML sources.
+ */
+bool isSourceFile(const char* name) {
+  size_t length = strlen(name);
+  return length > 3 && strcmp(name + length - 3, ".ch") == 0;
+}
+
+/**
+ * @brief Adds a page to the site, its output path mirrors its input path with
+ * the .ch extension swapped for .html.
+ *
+ * @param site Site* the site to add to.
+ * @param outputDir const char* the root output directory.
+ * @param input char* the source path, owned by the page.
+ * @param relative const char* the path relative to the input root.
+ * @param size off_t the size of the source in bytes.
+ * @return Page* the new page, valid until the next page is added.
+ */
+Page* addSitePage(Site* site, const char* outputDir, char* input,
+                  const char* relative, off_t size) {
+  if (site->count == site->capacity) {
+    site->capacity = site->capacity < 16 ? 16 : site->capacity * 2;
+    site->pages = realloc(site->pages, sizeof(Page) * site->capacity);
+  }
+
+  size_t stem = strlen(relative) - 3;
+  char* html = malloc(stem + 6);
+  memcpy(html, relative, stem);
+  memcpy(html + stem, ".html", 6);
+
+  Page* page = &site->pages[site->count++];
+  page->input = input;
+  page->output = joinPath(outputDir, html);
+  page->relative = strdup(relative);
+  page->size = size;
+  page->millis = 0;
+  page->gzipMillis = 0;
+  page->ok = false;
+  page->cached = false;
+  page->assets = NULL;
+  page->assetCount = 0;
+  page->error[0] = '\0';
+  free(html);
+  return page;
+}
+
+/**
+ * @brief Recursively collects the sources under a directory.
+ *
+ * @param site Site* the site to add pages to.
+ * @param inputDir const char* the root input directory.
+ * @param outputDir const char* the root output directory.
+ * @param relative const char* the directory being walked, relative to the
+ * input root.
+ * @return bool false if a directory could not be read.
+ */
+bool collectSitePages(Site* site, const char* inputDir,
+                      const char* outputDir, const char* relative) {
+  char* dirPath = joinPath(inputDir, relative);
+  DIR* dir = opendir(dirPath);
+  if (dir == NULL) {
+    fprintf(stderr, "Could not open directory '%s': %s\n", dirPath,
+            strerror(errno));
+    free(dirPath);
+    return false;
+  }
+
+  bool ok = true;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+
+    char* path = joinPath(dirPath, entry->d_name);
+    char* childRelative = joinPath(relative, entry->d_name);
+    struct stat info;
+    if (stat(path, &info) != 0) {
+      free(path);
+      free(childRelative);
+      continue;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+      ok = collectSitePages(site, inputDir, outputDir, childRelative) && ok;
+      free(path);
+    } else if (S_ISREG(info.st_mode) && isSourceFile(entry->d_name)) {
+      addSitePage(site, outputDir, path, childRelative, info.st_size);
+    } else {
+      free(path);
+    }
+    free(childRelative);
+  }
+
+  closedir(dir);
+  free(dirPath);
+  return ok;
+}
+
+/**
+ * @brief Frees the pages of a site.
+ *
+ * @param site Site* the site to free.
+ */
+void freeSite(Site* site) {
+  for (int i = 0; i < site->count; i++) {
+    free(site->pages[i].input);
+    free(site->pages[i].output);
+    free(site->pages[i].relative);
+    for (int j = 0; j < site->pages[i].assetCount; j++)
+      free(site->pages[i].assets[j]);
+    free(site->pages[i].assets);
+  }
+  free(site->pages);
+  site->pages = NULL;
+  site->count = 0;
+  site->capacity = 0;
+}
+
+/**
+ * @brief Rebases a path written in a page onto the output root.
+ *
+ * @param page Page* the page the path was written in.
+ * @param path const char* the path, relative to the page.
+ * @return char* the path relative to the output root, must be freed.
+ */
+static char* rootRelative(Page* page, const char* path) {
+  char* rebased = resolvePath(page->relative, path, strlen(path));
+  normalizePath(rebased);
+  return rebased;
+}
+
+/**
+ * @brief Records the stylesheets a page's last compile fingerprinted.
+ *
+ * @param page Page* the page that was compiled.
+ * @param context ChtmlContext* the context that compiled it.
+ */
+static void recordAssets(Page* page, ChtmlContext* context) {
+  int count = chtmlDependencyCount(context);
+  for (int i = 0; i < count; i++) {
+    const char* fingerprinted = chtmlDependencyFingerprint(context, i);
+    if (fingerprinted == NULL)
+      continue;
+    if (page->assets == NULL)
+      page->assets = malloc(sizeof(char*) * count * 2);
+    page->assets[page->assetCount++] =
+        rootRelative(page, chtmlDependency(context, i));
+    page->assets[page->assetCount++] = rootRelative(page, fingerprinted);
+  }
+}
+
+/**
+ * @brief Pool task compiling a single page with the worker's context.
+ *
+ * @param arg void* the PageTask to run.
+ * @param worker int the index of the worker running the task.
+ */
+static void compilePage(void* arg, int worker) {
+  PageTask* task = arg;
+  Page* page = task->page;
+
+  // contexts are per worker, so no two threads ever share one
+  ChtmlContext** context = &task->site->contexts[worker];
+  if (*context == NULL) {
+    *context = chtmlCreate();
+    chtmlSetGzip(*context, task->site->gzipLevel);
+    chtmlSetCssMode(*context, task->site->cssMode);
+    if (task->site->stats != NULL)
+      chtmlSetStats(*context, &task->site->stats[worker]);
+  }
+
+  double start = clockMillis();
+  if (task->site->cache != NULL)
+    page->ok = cacheCompileFile(task->site->cache, *context, page->input,
+                                page->output, &page->cached);
+  else
+    page->ok = chtmlCompileFile(*context, page->input, page->output);
+  page->millis = clockMillis() - start;
+  if (!page->cached)
+    page->gzipMillis = chtmlGzipMillis(*context);
+
+  if (!page->ok)
+    snprintf(page->error, sizeof(page->error), "%s", chtmlError(*context));
+  else if (task->site->cssMode == CHTML_CSS_FINGERPRINT)
+    recordAssets(page, *context);
+}
+
+/**
+ * @brief Orders pages largest first, so the biggest files start early rather
+ * than holding up the end of the build.
+ */
+static int compareSize(const void* a, const void* b) {
+  off_t left = ((const Page*)a)->size;
+  off_t right = ((const Page*)b)->size;
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+/**
+ * @brief Orders pages by path for a stable report.
+ */
+static int comparePath(const void* a, const void* b) {
+  return strcmp(((const Page*)a)->relative, ((const Page*)b)->relative);
+}
+
+/**
+ * @brief Orders original, fingerprinted path pairs by original path.
+ */
+static int compareAsset(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * @brief Appends a string to a JSON document as a quoted JSON string.
+ *
+ * @param json StringBuilder* the document.
+ * @param string const char* the string to quote.
+ */
+static void appendJsonString(StringBuilder* json, const char* string) {
+  builderAppend(json, "\"", 1);
+  for (const char* c = string; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      char escaped[2] = {'\\', *c};
+      builderAppend(json, escaped, 2);
+    } else if ((unsigned char)*c < 0x20) {
+      char escaped[7];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+      builderAppend(json, escaped, 6);
+    } else {
+      builderAppend(json, c, 1);
+    }
+  }
+  builderAppend(json, "\"", 1);
+}
+
+/**
+ * @brief Writes the manifest mapping each fingerprinted stylesheet's original
+ * path to its fingerprinted one, both relative to the output root, as a JSON
+ * object sorted by original path.
+ *
+ * @param site Site* the built site.
+ * @param outputDir const char* the root output directory.
+ * @return bool false if the manifest could not be written.
+ */
+static bool writeAssetManifest(Site* site, const char* outputDir) {
+  int count = 0;
+  for (int i = 0; i < site->count; i++)
+    count += site->pages[i].assetCount / 2;
+
+  // pages sharing a stylesheet each recorded it, keep one pair per path
+  char** assets = malloc(sizeof(char*) * (count * 2 + 1));
+  int pair = 0;
+  for (int i = 0; i < site->count; i++) {
+    memcpy(assets + pair * 2, site->pages[i].assets,
+           sizeof(char*) * site->pages[i].assetCount);
+    pair += site->pages[i].assetCount / 2;
+  }
+  qsort(assets, count, sizeof(char*) * 2, compareAsset);
+
+  StringBuilder json;
+  initBuilder(&json);
+  builderAppendString(&json, "{");
+  int written = 0;
+  for (int i = 0; i < count; i++) {
+    if (i > 0 && strcmp(assets[i * 2], assets[i * 2 - 2]) == 0)
+      continue;
+    builderAppendString(&json, written++ > 0 ? ",\n  " : "\n  ");
+    appendJsonString(&json, assets[i * 2]);
+    builderAppendString(&json, ": ");
+    appendJsonString(&json, assets[i * 2 + 1]);
+  }
+  builderAppendString(&json, written > 0 ? "\n}\n" : "}\n");
+
+  char* path = joinPath(outputDir, ASSET_MANIFEST_NAME);
+  bool ok = writeAtomically(path, json.chars, json.length);
+  if (!ok)
+    fprintf(stderr, "Could not write '%s': %s\n", path, strerror(errno));
+  free(path);
+  freeBuilder(&json);
+  free(assets);
+  return ok;
+}
+
+/**
+ * @brief Writes the asset manifest for a single page beside it, with paths
+ * relative to the page's directory, as a site build would for a site of one.
+ *
+ * @param context ChtmlContext* the context that compiled the page.
+ * @param outputPath const char* the page that was written.
+ * @return bool false if the manifest could not be written.
+ */
+bool writePageManifest(ChtmlContext* context, const char* outputPath) {
+  const char* slash = strrchr(outputPath, '/');
+  char* outputDir;
+  if (slash == NULL)
+    outputDir = strdup(".");
+  else if (slash == outputPath)
+    outputDir = strdup("/");
+  else
+    outputDir = strndup(outputPath, slash - outputPath);
+
+  Page page;
+  memset(&page, 0, sizeof(Page));
+  page.relative = (char*)(slash == NULL ? outputPath : slash + 1);
+  recordAssets(&page, context);
+
+  Site site = {&page, 1, 1, NULL, NULL, 0, CHTML_CSS_FINGERPRINT, NULL};
+  bool ok = writeAssetManifest(&site, outputDir);
+  for (int i = 0; i < page.assetCount; i++)
+    free(page.assets[i]);
+  free(page.assets);
+  free(outputDir);
+  return ok;
+}
+
+/**
+ * @brief Compiles every .ch file under inputDir into the same relative path
+ * under outputDir and reports per-file and total timings. With fingerprinted
+ * css the asset manifest is written to outputDir too.
+ *
+ * @param inputDir const char* the directory to read sources from.
+ * @param outputDir const char* the directory to write pages to.
+ * @param jobs int the number of worker threads, <= 0 uses one per core.
+ * @param gzipLevel int the level to also write gzipped pages at, 0 for none.
+ * @param cssMode ChtmlCssMode whether pages link, embed or fingerprint their
+ * stylesheets.
+ * @param cache Cache* the build cache to use, may be NULL.
+ * @param stats Stats* where to add up what every page's compile did, NULL
+ * for none.
+ * @return int the number of pages that failed to build, plus one if the
+ * manifest could not be written.
+ */
+int buildSite(const char* inputDir,
+              const char* outputDir,
+              int jobs,
+              int gzipLevel,
+              ChtmlCssMode cssMode,
+              Cache* cache,
+              Stats* stats) {
+  double start = clockMillis();
+
+  Site site = {NULL, 0, 0, NULL, cache, gzipLevel, cssMode, NULL};
+  if (!collectSitePages(&site, inputDir, outputDir, "")) {
+    freeSite(&site);
+    return 1;
+  }
+
+  // directories are made up front so workers never race on mkdir
+  for (int i = 0; i < site.count; i++) {
+    char* slash = strrchr(site.pages[i].output, '/');
+    if (slash == NULL)
+      continue;
+    *slash = '\0';
+    bool made = makeDirectories(site.pages[i].output);
+    *slash = '/';
+    if (!made) {
+      fprintf(stderr, "Could not create directory for '%s': %s\n",
+              site.pages[i].output, strerror(errno));
+      freeSite(&site);
+      return 1;
+    }
+  }
+
+  qsort(site.pages, site.count, sizeof(Page), compareSize);
+
+  ThreadPool pool;
+  initPool(&pool, jobs);
+  site.contexts = calloc(pool.workerCount, sizeof(ChtmlContext*));
+  // workers count separately, so the counters need no locking
+  if (stats != NULL)
+    site.stats = calloc(pool.workerCount, sizeof(Stats));
+  PageTask* tasks = malloc(sizeof(PageTask) * (site.count + 1));
+
+  for (int i = 0; i < site.count; i++) {
+    tasks[i].site = &site;
+    tasks[i].page = &site.pages[i];
+    poolSubmit(&pool, compilePage, &tasks[i]);
+  }
+  poolWait(&pool);
+
+  int workers = pool.workerCount;
+  freePool(&pool);
+  if (stats != NULL) {
+    for (int i = 0; i < workers; i++)
+      addStats(stats, &site.stats[i]);
+  }
+
+  qsort(site.pages, site.count, sizeof(Page), comparePath);
+
+  int failed = 0;
+  int cached = 0;
+  off_t bytes = 0;
+  double gzipMillis = 0;
+  for (int i = 0; i < site.count; i++) {
+    Page* page = &site.pages[i];
+    bytes += page->size;
+    gzipMillis += page->gzipMillis;
+    if (page->ok) {
+      printf("%10.3f ms  %s%s\n", page->millis, page->relative,
+             page->cached ? "  (cached)" : "");
+      cached += page->cached;
+    } else {
+      printf("%10.3f ms  %s  FAILED: %s\n", page->millis, page->relative,
+             page->error);
+      failed++;
+    }
+  }
+
+  double total = clockMillis() - start;
+  printf("Built %d page(s) (%d cached), %d failed, %.1f KiB in %.3f ms on %d "
+         "thread(s)\n",
+         site.count - failed, cached, failed, bytes / 1024.0, total, workers);
+  if (gzipLevel > 0)
+    printf("Gzipped at level %d, %.3f ms compressing summed over pages\n",
+           gzipLevel, gzipMillis);
+  if (cssMode == CHTML_CSS_FINGERPRINT && !writeAssetManifest(&site, outputDir))
+    failed++;
+
+  for (int i = 0; i < workers; i++)
+    chtmlDestroy(site.contexts[i]);
+  free(site.contexts);
+  free(site.stats);
+  freeSite(&site);
+  free(tasks);
+
+  return failed;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file site.h
+ * @author Devin Arena
+ * @brief Header for the parallel site builder.
+ * @since 11/18/2022
+ **/
+
+#ifndef CHTML_SITE_H
+#define CHTML_SITE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "cache.h"
+#include "chtml.h"
+
+typedef struct {
+  char* input;
+  char* output;
+  char* relative;
+  off_t size;
+  double millis;
+  // time spent writing the gzipped copy, part of millis
+  double gzipMillis;
+  bool ok;
+  bool cached;
+  // original and fingerprinted stylesheet paths relative to the output root,
+  // in pairs, for the asset manifest
+  char** assets;
+  int assetCount;
+  char error[256];
+} Page;
+
+typedef struct {
+  Page* pages;
+  int count;
+  int capacity;
+  ChtmlContext** contexts;
+  Cache* cache;
+  // pages are also written gzipped when this is above 0
+  int gzipLevel;
+  ChtmlCssMode cssMode;
+  // one per worker when stats are on, summed after the build
+  Stats* stats;
+} Site;
+
+bool isSourceFile(const char* name);
+Page* addSitePage(Site* site,
+                  const char* outputDir,
+                  char* input,
+                  const char* relative,
+                  off_t size);
+bool collectSitePages(Site* site,
+                      const char* inputDir,
+                      const char* outputDir,
+                      const char* relative);
+void freeSite(Site* site);
+bool writePageManifest(ChtmlContext* context, const char* outputPath);
+int buildSite(const char* inputDir,
+              const char* outputDir,
+              int jobs,
+              int gzipLevel,
+              ChtmlCssMode cssMode,
+              Cache* cache,
+              Stats* stats);
+
+#endif
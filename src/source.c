@@ -0,0 +1,136 @@
+/**
+ * @file source.c
+ * @author Devin Arena
+ * @brief Loads source files for the scanner. Regular files are memory mapped
+ * so the scanner reads the page cache directly, anything else (pipes, stdin,
+ * character devices) is read into a heap buffer.
+ * @since 11/14/2022
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+// initial size of the read buffer for inputs that cannot be mapped
+#define READ_CHUNK 65536
+
+/**
+ * @brief Reads everything from a descriptor into a heap buffer. Used when the
+ * input cannot be mapped, so the size is not known up front.
+ *
+ * @param source Source* the source to fill in.
+ * @param fd int the descriptor to read from.
+ * @return bool false if reading failed or memory ran out.
+ */
+static bool readSource(Source* source, int fd) {
+  size_t capacity = READ_CHUNK;
+  size_t length = 0;
+  char* buffer = malloc(capacity + 1);
+  if (buffer == NULL)
+    return false;
+
+  while (true) {
+    if (length == capacity) {
+      capacity *= 2;
+      char* grown = realloc(buffer, capacity + 1);
+      if (grown == NULL) {
+        free(buffer);
+        return false;
+      }
+      buffer = grown;
+    }
+
+    ssize_t count = read(fd, buffer + length, capacity - length);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      free(buffer);
+      return false;
+    }
+    if (count == 0)
+      break;
+    length += count;
+  }
+
+  // the scanner is bounds aware, but keep the terminator for debug printing
+  buffer[length] = '\0';
+
+  source->chars = buffer;
+  source->length = length;
+  source->mapped = false;
+  return true;
+}
+
+/**
+ * @brief Maps a regular file read-only and hints the kernel that it will be
+ * read front to back.
+ *
+ * @param source Source* the source to fill in.
+ * @param fd int the descriptor of the file.
+ * @param size size_t the size of the file.
+ * @return bool false if the file could not be mapped.
+ */
+static bool mapSource(Source* source, int fd, size_t size) {
+  void* pages = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (pages == MAP_FAILED)
+    return false;
+
+  madvise(pages, size, MADV_SEQUENTIAL);
+
+  source->chars = pages;
+  source->length = size;
+  source->mapped = true;
+  return true;
+}
+
+/**
+ * @brief Opens a source file. "-" reads from stdin.
+ *
+ * @param source Source* the source to fill in.
+ * @param path const char* the path of the file to open.
+ * @return bool false if the file could not be opened or read, errno is set.
+ */
+bool openSource(Source* source, const char* path) {
+  bool isStdin = strcmp(path, "-") == 0;
+  int fd = isStdin ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  bool loaded = false;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    loaded = mapSource(source, fd, info.st_size);
+
+  // pipes, empty files and anything mmap refuses fall back to reading
+  if (!loaded)
+    loaded = readSource(source, fd);
+
+  int error = errno;
+  if (!isStdin)
+    close(fd);
+  errno = error;
+
+  return loaded;
+}
+
+/**
+ * @brief Unmaps or frees the memory backing a source.
+ *
+ * @param source Source* the source to close.
+ */
+void closeSource(Source* source) {
+  if (source->mapped)
+    munmap((void*)source->chars, source->length);
+  else
+    free((void*)source->chars);
+
+  source->chars = NULL;
+  source->length = 0;
+  source->mapped = false;
+}
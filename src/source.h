@@ -0,0 +1,23 @@
+/**
+ * @file source.h
+ * @author Devin Arena
+ * @brief Header for loading source files, memory mapped where possible.
+ * @since 11/14/2022
+ **/
+
+#ifndef CHTML_SOURCE_H
+#define CHTML_SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+  const char* chars;
+  size_t length;
+  bool mapped;
+} Source;
+
+bool openSource(Source* source, const char* path);
+void closeSource(Source* source);
+
+#endif
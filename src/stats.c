@@ -0,0 +1,159 @@
+/**
+ * @file stats.c
+ * @author Devin Arena
+ * @brief Compile statistics. The compiler fills them in only when a context
+ * is given somewhere to put them, so they can stay built in.
+ * @since 12/6/2022
+ **/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "stats.h"
+
+// the names the phases are reported under
+static const char* phaseNames[STATS_PHASE_COUNT] = {
+    "readFile", "scanning", "compiling", "writeOutput", "gzip"};
+
+/**
+ * @brief Zeroes every timer and counter.
+ *
+ * @param stats Stats* the stats to initialize.
+ */
+void initStats(Stats* stats) {
+  memset(stats, 0, sizeof(Stats));
+}
+
+/**
+ * @brief Adds one set of stats to another, as when workers' stats are
+ * summed for a whole build.
+ *
+ * @param to Stats* the stats to add to.
+ * @param from const Stats* the stats to add.
+ */
+void addStats(Stats* to, const Stats* from) {
+  for (int i = 0; i < STATS_PHASE_COUNT; i++)
+    to->millis[i] += from->millis[i];
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++)
+    to->tokens[i] += from->tokens[i];
+  to->macroDefinitions += from->macroDefinitions;
+  to->macroExpansions += from->macroExpansions;
+  to->bytesEmitted += from->bytesEmitted;
+  to->outputReallocations += from->outputReallocations;
+  to->heapAllocations += from->heapAllocations;
+  to->countsHeap = to->countsHeap || from->countsHeap;
+  if (from->maxDepth > to->maxDepth)
+    to->maxDepth = from->maxDepth;
+}
+
+/**
+ * @brief Reports time spent compressing as its own phase. Pages are gzipped
+ * as they are written, so the time is moved out of writing.
+ *
+ * @param stats Stats* the stats to add to.
+ * @param millis double the time a GzipWriter spent compressing.
+ */
+void addGzipMillis(Stats* stats, double millis) {
+  stats->millis[STATS_GZIP] += millis;
+  stats->millis[STATS_WRITE] -= millis;
+}
+
+/**
+ * @brief Counts a compile's macro definitions and their bodies' tokens.
+ * Definitions in a row scan as a single TOKEN_MACRO and bodies are scanned
+ * inside it, so they are counted from the definitions instead.
+ *
+ * @param stats Stats* the stats to add to.
+ * @param defined Macro** the scanner's definitions.
+ * @param count int the number of definitions.
+ */
+void addDefinitions(Stats* stats, Macro** defined, int count) {
+  stats->macroDefinitions += count;
+  stats->tokens[TOKEN_MACRO] += count;
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < defined[i]->count; j++)
+      stats->tokens[defined[i]->tokens[j].type]++;
+  }
+}
+
+/**
+ * @brief Prints stats as an indented report.
+ *
+ * @param stats const Stats* the stats to print.
+ * @param file FILE* where to print them.
+ */
+static void printText(const Stats* stats, FILE* file) {
+  fprintf(file, "Stats\n");
+  for (int i = 0; i < STATS_PHASE_COUNT; i++)
+    fprintf(file, "  %-22s %12.3f ms\n", phaseNames[i], stats->millis[i]);
+
+  uint64_t tokens = 0;
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++)
+    tokens += stats->tokens[i];
+  fprintf(file, "  %-22s %12" PRIu64 "\n", "tokens", tokens);
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+    if (stats->tokens[i] > 0)
+      fprintf(file, "    %-20s %12" PRIu64 "\n", tokenTypeName(i),
+              stats->tokens[i]);
+  }
+
+  fprintf(file, "  %-22s %12" PRIu64 "\n", "macro definitions",
+          stats->macroDefinitions);
+  fprintf(file, "  %-22s %12" PRIu64 "\n", "macro expansions",
+          stats->macroExpansions);
+  fprintf(file, "  %-22s %12" PRIu64 "\n", "bytes emitted",
+          stats->bytesEmitted);
+  fprintf(file, "  %-22s %12" PRIu64 "\n", "output reallocations",
+          stats->outputReallocations);
+  if (stats->countsHeap)
+    fprintf(file, "  %-22s %12" PRIu64 "\n", "heap allocations",
+            stats->heapAllocations);
+  else
+    fprintf(file, "  %-22s %12s\n", "heap allocations", "-");
+  fprintf(file, "  %-22s %12d\n", "max tag depth", stats->maxDepth);
+}
+
+/**
+ * @brief Prints stats as a single JSON object.
+ *
+ * @param stats const Stats* the stats to print.
+ * @param file FILE* where to print them.
+ */
+static void printJson(const Stats* stats, FILE* file) {
+  fprintf(file, "{\"millis\": {");
+  for (int i = 0; i < STATS_PHASE_COUNT; i++)
+    fprintf(file, "%s\"%s\": %.3f", i > 0 ? ", " : "", phaseNames[i],
+            stats->millis[i]);
+
+  fprintf(file, "}, \"tokens\": {");
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++)
+    fprintf(file, "%s\"%s\": %" PRIu64, i > 0 ? ", " : "", tokenTypeName(i),
+            stats->tokens[i]);
+
+  fprintf(file,
+          "}, \"macroDefinitions\": %" PRIu64 ", \"macroExpansions\": %" PRIu64
+          ", \"bytesEmitted\": %" PRIu64 ", \"outputReallocations\": %" PRIu64
+          ", ",
+          stats->macroDefinitions, stats->macroExpansions,
+          stats->bytesEmitted, stats->outputReallocations);
+  if (stats->countsHeap)
+    fprintf(file, "\"heapAllocations\": %" PRIu64 ", ",
+            stats->heapAllocations);
+  else
+    fprintf(file, "\"heapAllocations\": null, ");
+  fprintf(file, "\"maxTagDepth\": %d}\n", stats->maxDepth);
+}
+
+/**
+ * @brief Prints stats as text or JSON.
+ *
+ * @param stats const Stats* the stats to print.
+ * @param file FILE* where to print them.
+ * @param json bool true for a JSON object, false for a report.
+ */
+void printStats(const Stats* stats, FILE* file, bool json) {
+  if (json)
+    printJson(stats, file);
+  else
+    printText(stats, file);
+}
@@ -0,0 +1,58 @@
+/**
+ * @file stats.h
+ * @author Devin Arena
+ * @brief Header for compile statistics, per-phase timers and counters from
+ * the hot paths.
+ * @since 12/6/2022
+ **/
+
+#ifndef CHTML_STATS_H
+#define CHTML_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "scanner.h"
+
+// counting sites test the stats pointer, a branch that is never taken when
+// stats are off, building with CHTML_NO_STATS removes them altogether
+#ifdef CHTML_NO_STATS
+#define STATS_ON(stats) false
+#else
+#define STATS_ON(stats) __builtin_expect((stats) != NULL, 0)
+#endif
+
+typedef enum {
+  STATS_READ,
+  STATS_SCAN,
+  STATS_COMPILE,
+  STATS_WRITE,
+  STATS_GZIP,
+  STATS_PHASE_COUNT,
+} StatsPhase;
+
+// summed over every compile given the same stats
+typedef struct Stats {
+  double millis[STATS_PHASE_COUNT];
+  // tokens scanned from the source, counting each definition as a
+  // TOKEN_MACRO and its body once, however often it is called
+  uint64_t tokens[TOKEN_TYPE_COUNT];
+  uint64_t macroDefinitions;
+  uint64_t macroExpansions;
+  uint64_t bytesEmitted;
+  // times a memory sink's buffer had to grow
+  uint64_t outputReallocations;
+  // filled in by the program, the library has no view of the heap
+  uint64_t heapAllocations;
+  bool countsHeap;
+  int maxDepth;
+} Stats;
+
+void initStats(Stats* stats);
+void addStats(Stats* to, const Stats* from);
+void addGzipMillis(Stats* stats, double millis);
+void addDefinitions(Stats* stats, Macro** defined, int count);
+void printStats(const Stats* stats, FILE* file, bool json);
+
+#endif
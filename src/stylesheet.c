@@ -0,0 +1,411 @@
+/**
+ * @file stylesheet.c
+ * @author Devin Arena
+ * @brief Reads stylesheets for documents that inline or fingerprint them. Each
+ * file is read (and minified) or hashed once per process and kept by path,
+ * then reused until its modification time or size changes, so a site whose
+ * pages share a stylesheet reads it a single time.
+ * @since 12/4/2022
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "path.h"
+#include "source.h"
+#include "stylesheet.h"
+#include "table.h"
+
+// bytes read from a stylesheet at a time
+#define STYLESHEET_CHUNK_SIZE 65536
+// hex digits of the content hash in a fingerprinted name
+#define FINGERPRINT_DIGITS 8
+
+typedef struct {
+  struct timespec mtime;
+  off_t size;
+  char* chars;
+  size_t length;
+} CachedStylesheet;
+
+typedef struct {
+  struct timespec mtime;
+  off_t size;
+  uint64_t hash;
+} HashedStylesheet;
+
+// keyed by the canonical path, prefixed with whether it was minified
+static Table stylesheets;
+// content hashes of fingerprinted stylesheets, keyed by the canonical path
+static Table hashes;
+static pthread_mutex_t stylesheetsLock = PTHREAD_MUTEX_INITIALIZER;
+static bool stylesheetsReady = false;
+
+/**
+ * @brief Starts a minifier at the beginning of a stylesheet.
+ *
+ * @param minifier CssMinifier* the minifier to initialize.
+ */
+void initCssMinifier(CssMinifier* minifier) {
+  minifier->state = CSS_NORMAL;
+  minifier->quote = '\0';
+  minifier->last = '\0';
+  minifier->pendingSpace = false;
+  minifier->pendingSemicolon = false;
+}
+
+/**
+ * @brief Checks if whitespace next to a character can be dropped.
+ */
+static bool isPunctuation(char c) {
+  return c == '{' || c == '}' || c == ';' || c == ',' || c == ':' ||
+         c == '\0';
+}
+
+/**
+ * @brief Writes a character outside of a comment, with the space or
+ * semicolon held back before it if it still needs one.
+ *
+ * @param minifier CssMinifier* the minifier writing.
+ * @param c char the character.
+ * @param output StringBuilder* where to write.
+ */
+static void emitCss(CssMinifier* minifier, char c, StringBuilder* output) {
+  if (minifier->pendingSemicolon) {
+    minifier->pendingSemicolon = false;
+    if (c != '}') {
+      builderAppend(output, ";", 1);
+      minifier->last = ';';
+    }
+  }
+
+  // "a :hover" and "a:hover" differ, so only the space after a ':' goes
+  if (minifier->pendingSpace) {
+    minifier->pendingSpace = false;
+    if (!isPunctuation(minifier->last) && c != '{' && c != '}' && c != ';' &&
+        c != ',')
+      builderAppend(output, " ", 1);
+  }
+
+  if (c == ';') {
+    minifier->pendingSemicolon = true;
+    return;
+  }
+  builderAppend(output, &c, 1);
+  minifier->last = c;
+}
+
+/**
+ * @brief Minifies the next chunk of a stylesheet. Chunks may split anything,
+ * comments and strings included.
+ *
+ * @param minifier CssMinifier* the minifier's state.
+ * @param chars const char* the chunk.
+ * @param length size_t the length of the chunk.
+ * @param output StringBuilder* where to write the minified css.
+ */
+void minifyCss(CssMinifier* minifier, const char* chars, size_t length,
+               StringBuilder* output) {
+  for (size_t i = 0; i < length; i++) {
+    char c = chars[i];
+    switch (minifier->state) {
+      case CSS_NORMAL:
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+          minifier->pendingSpace = true;
+        } else if (c == '/') {
+          minifier->state = CSS_SLASH;
+        } else {
+          emitCss(minifier, c, output);
+          if (c == '"' || c == '\'') {
+            minifier->quote = c;
+            minifier->state = CSS_STRING;
+          }
+        }
+        break;
+      case CSS_STRING:
+        builderAppend(output, &c, 1);
+        if (c == '\\')
+          minifier->state = CSS_STRING_ESCAPE;
+        else if (c == minifier->quote)
+          minifier->state = CSS_NORMAL;
+        break;
+      case CSS_STRING_ESCAPE:
+        builderAppend(output, &c, 1);
+        minifier->state = CSS_STRING;
+        break;
+      case CSS_SLASH:
+        if (c == '*') {
+          minifier->state = CSS_COMMENT;
+        } else {
+          // not a comment, the '/' is written and c is looked at again
+          emitCss(minifier, '/', output);
+          minifier->state = CSS_NORMAL;
+          i--;
+        }
+        break;
+      case CSS_COMMENT:
+        if (c == '*')
+          minifier->state = CSS_COMMENT_STAR;
+        break;
+      case CSS_COMMENT_STAR:
+        if (c == '/') {
+          // a comment still separates what is either side of it
+          minifier->pendingSpace = true;
+          minifier->state = CSS_NORMAL;
+        } else if (c != '*') {
+          minifier->state = CSS_COMMENT;
+        }
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Writes anything the minifier held back at the end of a stylesheet.
+ * Trailing whitespace and a final ';' are dropped.
+ *
+ * @param minifier CssMinifier* the minifier to finish.
+ * @param output StringBuilder* where to write.
+ */
+void finishCssMinifier(CssMinifier* minifier, StringBuilder* output) {
+  if (minifier->state == CSS_SLASH) {
+    minifier->pendingSpace = false;
+    emitCss(minifier, '/', output);
+  }
+  minifier->state = CSS_NORMAL;
+}
+
+/**
+ * @brief Reads a stylesheet a chunk at a time, minifying each chunk as it
+ * arrives.
+ *
+ * @param fd int the open stylesheet.
+ * @param minify bool whether to minify it.
+ * @param output StringBuilder* where to write the css.
+ * @return bool false if the file could not be read.
+ */
+static bool readStylesheet(int fd, bool minify, StringBuilder* output) {
+  CssMinifier minifier;
+  initCssMinifier(&minifier);
+  char* chunk = malloc(STYLESHEET_CHUNK_SIZE);
+
+  bool ok = true;
+  while (true) {
+    ssize_t count = read(fd, chunk, STYLESHEET_CHUNK_SIZE);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0) {
+      ok = count == 0;
+      break;
+    }
+    if (minify)
+      minifyCss(&minifier, chunk, count, output);
+    else
+      builderAppend(output, chunk, count);
+  }
+
+  if (minify)
+    finishCssMinifier(&minifier, output);
+  free(chunk);
+  return ok;
+}
+
+/**
+ * @brief Takes the lock guarding the caches, creating them on first use.
+ */
+static void lockStylesheets() {
+  pthread_mutex_lock(&stylesheetsLock);
+  if (!stylesheetsReady) {
+    initTable(&stylesheets);
+    initTable(&hashes);
+    stylesheetsReady = true;
+  }
+}
+
+/**
+ * @brief Checks whether a css path names a local file rather than a url
+ * (anything with a "//"), which is left to the browser.
+ *
+ * @param href const char* the path as written, need not be NUL terminated.
+ * @param length size_t the length of the path.
+ * @return bool true if the path can be read from disk.
+ */
+bool isLocalStylesheet(const char* href, size_t length) {
+  for (size_t i = 0; i + 1 < length; i++) {
+    if (href[i] == '/' && href[i + 1] == '/')
+      return false;
+  }
+  return length > 0;
+}
+
+/**
+ * @brief Loads a stylesheet into an arena, from the cache when the file has
+ * not changed since it was last read. Safe to call from several threads.
+ *
+ * @param path const char* the stylesheet's path.
+ * @param minify bool whether to minify it.
+ * @param arena Arena* where to copy the css, it must outlive the output.
+ * @param chars const char** set to the css.
+ * @param length size_t* set to the length of the css.
+ * @return bool false if the stylesheet could not be read.
+ */
+bool loadStylesheet(const char* path, bool minify, Arena* arena,
+                    const char** chars, size_t* length) {
+  char* canonical = canonicalPath(path);
+  struct stat info;
+  if (canonical == NULL || stat(canonical, &info) != 0 ||
+      !S_ISREG(info.st_mode)) {
+    free(canonical);
+    return false;
+  }
+
+  size_t pathLength = strlen(canonical);
+  char* key = malloc(pathLength + 2);
+  key[0] = minify ? 'm' : 'r';
+  memcpy(key + 1, canonical, pathLength + 1);
+  free(canonical);
+
+  // held while a missing stylesheet is read, so it is only read once
+  lockStylesheets();
+
+  CachedStylesheet* cached = tableGet(&stylesheets, key);
+  if (cached != NULL && (cached->size != info.st_size ||
+                         cached->mtime.tv_sec != info.st_mtim.tv_sec ||
+                         cached->mtime.tv_nsec != info.st_mtim.tv_nsec)) {
+    tableDelete(&stylesheets, key);
+    free(cached->chars);
+    free(cached);
+    cached = NULL;
+  }
+
+  if (cached == NULL) {
+    int fd = open(key + 1, O_RDONLY);
+    StringBuilder css;
+    initBuilder(&css);
+    if (fd >= 0 && readStylesheet(fd, minify, &css)) {
+      cached = malloc(sizeof(CachedStylesheet));
+      cached->mtime = info.st_mtim;
+      cached->size = info.st_size;
+      cached->chars = css.chars;
+      cached->length = css.length;
+      tableSet(&stylesheets, key, cached);
+    } else {
+      freeBuilder(&css);
+    }
+    if (fd >= 0)
+      close(fd);
+  }
+
+  if (cached != NULL) {
+    *length = cached->length;
+    *chars = cached->length > 0
+                 ? arenaCopy(arena, cached->chars, cached->length)
+                 : "";
+  }
+  pthread_mutex_unlock(&stylesheetsLock);
+
+  free(key);
+  return cached != NULL;
+}
+
+/**
+ * @brief Hashes a stylesheet's contents, from the cache when the file has not
+ * changed since it was last hashed. Safe to call from several threads.
+ *
+ * @param path const char* the stylesheet's path.
+ * @param hash uint64_t* set to the hash.
+ * @return bool false if the stylesheet could not be read.
+ */
+bool hashStylesheet(const char* path, uint64_t* hash) {
+  char* canonical = canonicalPath(path);
+  struct stat info;
+  if (canonical == NULL || stat(canonical, &info) != 0 ||
+      !S_ISREG(info.st_mode)) {
+    free(canonical);
+    return false;
+  }
+
+  lockStylesheets();
+  HashedStylesheet* hashed = tableGet(&hashes, canonical);
+  if (hashed != NULL && (hashed->size != info.st_size ||
+                         hashed->mtime.tv_sec != info.st_mtim.tv_sec ||
+                         hashed->mtime.tv_nsec != info.st_mtim.tv_nsec)) {
+    tableDelete(&hashes, canonical);
+    free(hashed);
+    hashed = NULL;
+  }
+
+  if (hashed == NULL) {
+    Source source;
+    if (openSource(&source, canonical)) {
+      hashed = malloc(sizeof(HashedStylesheet));
+      hashed->mtime = info.st_mtim;
+      hashed->size = info.st_size;
+      hashed->hash = hash64(HASH64_SEED, source.chars, source.length);
+      tableSet(&hashes, canonical, hashed);
+      closeSource(&source);
+    }
+  }
+
+  if (hashed != NULL)
+    *hash = hashed->hash;
+  pthread_mutex_unlock(&stylesheetsLock);
+
+  free(canonical);
+  return hashed != NULL;
+}
+
+/**
+ * @brief Works out the fingerprinted name of a linked stylesheet, its path
+ * with part of its content hash before the extension ("css/site.css" becomes
+ * "css/site.3f9a1c2b.css"), so the name changes whenever the file does.
+ *
+ * @param sourcePath const char* the document the path was written in, NULL
+ * for the working directory.
+ * @param href const char* the path as written, need not be NUL terminated.
+ * @param length size_t the length of the path.
+ * @return char* the fingerprinted path, must be freed, or NULL for urls,
+ * absolute paths and stylesheets that can't be read.
+ */
+char* fingerprintStylesheet(const char* sourcePath, const char* href,
+                            size_t length) {
+  // absolute paths name a file on the server, not beside the output
+  if (!isLocalStylesheet(href, length) || href[0] == '/')
+    return NULL;
+
+  char* path = resolvePath(sourcePath != NULL ? sourcePath : "", href, length);
+  uint64_t hash;
+  bool ok = hashStylesheet(path, &hash);
+  free(path);
+  if (!ok)
+    return NULL;
+
+  // the extension of the last component, if it has one past its first char
+  size_t name = length;
+  while (name > 0 && href[name - 1] != '/')
+    name--;
+  size_t dot = length;
+  for (size_t i = length; i > name + 1; i--) {
+    if (href[i - 1] == '.') {
+      dot = i - 1;
+      break;
+    }
+  }
+
+  char* fingerprinted = malloc(length + FINGERPRINT_DIGITS + 2);
+  memcpy(fingerprinted, href, dot);
+  // the high bits, FNV mixes each byte up rather than down
+  snprintf(fingerprinted + dot, FINGERPRINT_DIGITS + 2, ".%08x",
+           (unsigned)(hash >> 32));
+  memcpy(fingerprinted + dot + FINGERPRINT_DIGITS + 1, href + dot,
+         length - dot);
+  fingerprinted[length + FINGERPRINT_DIGITS + 1] = '\0';
+  return fingerprinted;
+}
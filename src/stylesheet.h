@@ -0,0 +1,53 @@
+/**
+ * @file stylesheet.h
+ * @author Devin Arena
+ * @brief Header for reading stylesheets to inline, minified on the way in,
+ * or to fingerprint, cached across documents.
+ * @since 12/4/2022
+ **/
+
+#ifndef CHTML_STYLESHEET_H
+#define CHTML_STYLESHEET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "builder.h"
+
+typedef enum {
+  CSS_NORMAL,
+  CSS_STRING,
+  CSS_STRING_ESCAPE,
+  // a '/' that may start a comment
+  CSS_SLASH,
+  CSS_COMMENT,
+  CSS_COMMENT_STAR,
+} CssState;
+
+// strips comments and needless whitespace from css fed to it in chunks of
+// any size, strings are copied as they are
+typedef struct {
+  CssState state;
+  char quote;
+  // the last character written, 0 before the first
+  char last;
+  bool pendingSpace;
+  // a ';' held back in case it ends a block, where it is not needed
+  bool pendingSemicolon;
+} CssMinifier;
+
+void initCssMinifier(CssMinifier* minifier);
+void minifyCss(CssMinifier* minifier, const char* chars, size_t length,
+               StringBuilder* output);
+void finishCssMinifier(CssMinifier* minifier, StringBuilder* output);
+bool isLocalStylesheet(const char* href, size_t length);
+bool loadStylesheet(const char* path, bool minify, Arena* arena,
+                    const char** chars, size_t* length);
+
+bool hashStylesheet(const char* path, uint64_t* hash);
+char* fingerprintStylesheet(const char* sourcePath, const char* href,
+                            size_t length);
+
+#endif
@@ -1,4 +1,3 @@
-
 /**
  * @file table.c
  * @author Devin Arena
@@ -14,6 +13,10 @@
 
 // max load before table resizes
 #define TABLE_MAX_LOAD 0.75
+// tables usually hold a handful of macro names
+#define TABLE_KEY_BLOCK_SIZE 1024
+// deleted keys are reclaimed once there are at least this many bytes of them
+#define TABLE_MIN_DEAD_KEYS 4096
 
 /**
  * @brief Initializes a table by zeroing out all of its memory.
@@ -24,75 +27,88 @@ void initTable(Table* table) {
   table->count = 0;
   table->capacity = 0;
   table->entries = NULL;
+  initArena(&table->keys);
+  table->keys.blockSize = TABLE_KEY_BLOCK_SIZE;
+  table->deadKeyBytes = 0;
+  table->liveKeyBytes = 0;
 }
 
 /**
- * @brief Frees a table by freeing its entries and zeroing its memory.
+ * @brief Frees a table by freeing its entries and keys and zeroing its
+ * memory.
  *
  * @param table Table* the table to free.
  */
 void freeTable(Table* table) {
   free(table->entries);
+  freeArena(&table->keys);
   initTable(table);
 }
 
+/**
+ * @brief Removes every entry but keeps the table's memory, so refilling it
+ * with a similar number of keys allocates nothing.
+ *
+ * @param table Table* the table to clear.
+ */
+void clearTable(Table* table) {
+  if (table->entries != NULL)
+    memset(table->entries, 0, sizeof(Entry) * table->capacity);
+  table->count = 0;
+  resetArena(&table->keys);
+  table->deadKeyBytes = 0;
+  table->liveKeyBytes = 0;
+}
+
 /**
  * @brief Takes the hash of the key and searches the array for it, if it doesnt
- * find it, it linear searches from that position.
+ * find it, it linear searches from that position. Entries are told apart by
+ * their hash and length before their characters are compared.
  *
  * @param entries Entry* the array of entries to search.
  * @param capacity int the capacity of the array.
- * @param key PdString* the key to search for.
- * @return Entry* the entry that was found.
+ * @param chars const char* the key to search for.
+ * @param length int the length of the key.
+ * @param hash uint32_t the hash of the key.
+ * @return Entry* the entry holding the key, or the empty entry it belongs in.
  */
-static Entry* findEntry(Entry* entries, int capacity, char* key) {
-  uint32_t index = (HASH_STRING(key) & (capacity - 1));
-  Entry* tombstone = NULL;
+static Entry* findEntry(Entry* entries,
+                        int capacity,
+                        const char* chars,
+                        int length,
+                        uint32_t hash) {
+  uint32_t index = hash & (capacity - 1);
 
   while (true) {
     Entry* entry = &entries[index];
 
-    if (entry->key == NULL) {
-      if (entry->value == NULL) {
-        return tombstone != NULL ? tombstone : entry;
-      } else {
-        if (tombstone == NULL)
-          tombstone = entry;
-      }
-    } else if (strcmp(entry->key, key) == 0) {
+    if (entry->key == NULL ||
+        (entry->hash == hash && entry->length == (uint32_t)length &&
+         memcmp(entry->key, chars, length) == 0))
       return entry;
-    }
 
     index = (index + 1) & (capacity - 1);
   }
-  
-  return NULL;
 }
 
 /**
  * @brief Adjusts the capacity of the table by creating a new entries array and
- * copying the old entries into it.
+ * moving the old entries into it, by their stored hashes.
  *
  * @param table Table* the table to adjust.
  * @param capacity int the new capacity of the table.
  */
 static void adjustCapacity(Table* table, int capacity) {
-  Entry* entries = malloc(sizeof(Entry) * capacity);
-  for (int i = 0; i < capacity; i++) {
-    entries[i].key = NULL;
-    entries[i].value = NULL;
-  }
+  Entry* entries = calloc(capacity, sizeof(Entry));
 
-  table->count = 0;
   for (int i = 0; i < table->capacity; i++) {
     Entry* entry = &table->entries[i];
     if (entry->key == NULL)
       continue;
 
-    Entry* dest = findEntry(entries, capacity, entry->key);
-    dest->key = entry->key;
-    dest->value = entry->value;
-    table->count++;
+    Entry* dest = findEntry(entries, capacity, entry->key, entry->length,
+                            entry->hash);
+    *dest = *entry;
   }
 
   free(table->entries);
@@ -102,72 +118,168 @@ static void adjustCapacity(Table* table, int capacity) {
 }
 
 /**
- * @brief Gets a value from the table by searching for the key. Assigns the
- * value to the value pointer. If the key is not found, it returns false.
+ * @brief Moves the live keys into a fresh arena, dropping the characters of
+ * deleted ones.
+ *
+ * @param table Table* the table to compact.
+ */
+static void compactKeys(Table* table) {
+  Arena keys;
+  initArena(&keys);
+  keys.blockSize = TABLE_KEY_BLOCK_SIZE;
+
+  for (int i = 0; i < table->capacity; i++) {
+    Entry* entry = &table->entries[i];
+    if (entry->key != NULL)
+      entry->key = arenaCopy(&keys, entry->key, entry->length + 1);
+  }
+
+  freeArena(&table->keys);
+  table->keys = keys;
+  table->deadKeyBytes = 0;
+}
+
+/**
+ * @brief Gets a value from the table by searching for the key.
  *
  * @param table Table* the table to search.
- * @param key PdString* the key to search for.
- * @return bool true if the key was found, false otherwise.
+ * @param key const char* the NUL terminated key to search for.
+ * @return void* the value, or NULL if the key was not found.
  */
-char* tableGet(Table* table, char* key) {
-  if (table->count == 0)
-    return NULL;
+void* tableGet(Table* table, const char* key) {
+  return tableGetString(table, key, strlen(key));
+}
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
-  if (entry->key == NULL)
+/**
+ * @brief Gets a value from the table by a key that need not be NUL
+ * terminated, such as a span of the source.
+ *
+ * @param table Table* the table to search.
+ * @param chars const char* the characters of the key.
+ * @param length int the length of the key.
+ * @return void* the value, or NULL if the key was not found.
+ */
+void* tableGetString(Table* table, const char* chars, int length) {
+  if (table->count == 0)
     return NULL;
 
-  return entry->value;
+  Entry* entry = findEntry(table->entries, table->capacity, chars, length,
+                           hashString(chars, length));
+  return entry->key == NULL ? NULL : entry->value;
 }
 
 /**
- * @brief Sets a value in the table, incrementing the count if the key is not in
- * the table. Adjusts the capacity if the load factor is greater than the max
+ * @brief Sets a value for a key with a known hash, interning the key if it
+ * is new. Adjusts the capacity if the load factor is greater than the max
  * load.
  *
- * @param table Table* the table to set the value in.
- * @param key PdString* the key to set the value for.
- * @param value Value the value to set.
- * @return bool true if the key is not found, false otherwise.
+ * @return bool true if the key is new, false otherwise.
  */
-bool tableSet(Table* table, char* key, char* value) {
+static bool setEntry(Table* table,
+                     const char* chars,
+                     int length,
+                     uint32_t hash,
+                     void* value) {
   if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
     int capacity = table->capacity < 8 ? 8 : table->capacity * 2;
     adjustCapacity(table, capacity);
   }
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
+  Entry* entry =
+      findEntry(table->entries, table->capacity, chars, length, hash);
   bool isNewKey = entry->key == NULL;
-  if (isNewKey && entry->value == NULL)
+  if (isNewKey) {
+    if (table->deadKeyBytes >= TABLE_MIN_DEAD_KEYS &&
+        table->deadKeyBytes > table->liveKeyBytes)
+      compactKeys(table);
+
+    char* key = arenaAlloc(&table->keys, length + 1);
+    memcpy(key, chars, length);
+    key[length] = '\0';
+
+    entry->key = key;
+    entry->length = length;
+    entry->hash = hash;
     table->count++;
+    table->liveKeyBytes += length + 1;
+  }
 
-  entry->key = key;
   entry->value = value;
   return isNewKey;
 }
 
 /**
- * @brief Deletes an entry from the table by setting it to be a tombstone.
+ * @brief Sets a value in the table, incrementing the count if the key is not in
+ * the table. The table keeps its own copy of the key.
+ *
+ * @param table Table* the table to set the value in.
+ * @param key const char* the NUL terminated key to set the value for.
+ * @param value void* the value to set.
+ * @return bool true if the key is new, false otherwise.
+ */
+bool tableSet(Table* table, const char* key, void* value) {
+  return tableSetString(table, key, strlen(key), value);
+}
+
+/**
+ * @brief Sets a value in the table by a key that need not be NUL terminated.
+ *
+ * @param table Table* the table to set the value in.
+ * @param chars const char* the characters of the key.
+ * @param length int the length of the key.
+ * @param value void* the value to set.
+ * @return bool true if the key is new, false otherwise.
+ */
+bool tableSetString(Table* table, const char* chars, int length,
+                    void* value) {
+  return setEntry(table, chars, length, hashString(chars, length), value);
+}
+
+/**
+ * @brief Deletes an entry from the table. Rather than leaving a tombstone,
+ * the entries after it in its probe run are shifted back into the gap, so
+ * lookups never walk over deleted entries and the table never needs
+ * rebuilding to get rid of them.
  *
  * @param table Table* the table to delete the entry from.
- * @param key PdString* the key to delete.
+ * @param key const char* the key to delete.
  * @return bool true if the key was found, false otherwise.
  */
-bool tableDelete(Table* table, char* key) {
+bool tableDelete(Table* table, const char* key) {
   if (table->count == 0)
     return false;
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
+  int length = strlen(key);
+  Entry* entry = findEntry(table->entries, table->capacity, key, length,
+                           hashString(key, length));
   if (entry->key == NULL)
     return false;
 
-  entry->key = NULL;
-  entry->value = "!tombstone"; // tombstone
+  table->deadKeyBytes += entry->length + 1;
+  table->liveKeyBytes -= entry->length + 1;
+  table->count--;
+
+  uint32_t mask = table->capacity - 1;
+  uint32_t hole = entry - table->entries;
+  uint32_t index = (hole + 1) & mask;
+  while (table->entries[index].key != NULL) {
+    Entry* next = &table->entries[index];
+    // an entry can fill the hole unless its home slot lies after the hole
+    uint32_t home = next->hash & mask;
+    if (((index - home) & mask) >= ((index - hole) & mask)) {
+      table->entries[hole] = *next;
+      hole = index;
+    }
+    index = (index + 1) & mask;
+  }
+
+  table->entries[hole].key = NULL;
+  table->entries[hole].value = NULL;
   return true;
 }
 
 /**
- * @brief Copies all entires from one table to another.
+ * @brief Copies all entires from one table to another, reusing their hashes.
  *
  * @param from Table* the table to copy from.
  * @param to Table* the table to copy to.
@@ -178,7 +290,7 @@ void tableAddAll(Table* from, Table* to) {
     if (entry->key == NULL)
       continue;
 
-    tableSet(to, entry->key, entry->value);
+    setEntry(to, entry->key, entry->length, entry->hash, entry->value);
   }
 }
 
@@ -187,31 +299,17 @@ void tableAddAll(Table* from, Table* to) {
  * and length.
  *
  * @param table Table* the table to search.
- * @param chars char* the characters to search for.
+ * @param chars const char* the characters to search for.
  * @param length int the length of the string.
- * @param hash uint32_t the hash of the string.
- * @return PdString* the string that was found or NULL.
+ * @param hash uint32_t the hash of the string, from hashString.
+ * @return const char* the interned string that was found or NULL.
  */
-char* tableFindString(Table* table,
-                           const char* chars,
-                           int length,
-                           uint32_t hash) {
+const char* tableFindString(Table* table,
+                            const char* chars,
+                            int length,
+                            uint32_t hash) {
   if (table->count == 0)
     return NULL;
 
-  uint32_t index = hash & (table->capacity - 1);
-
-  while (true) {
-    Entry* entry = &table->entries[index];
-
-    if (entry->key == NULL) {
-      if (entry->value== NULL)
-        return NULL;
-    } else if (strlen(entry->key) == length && HASH_STRING(entry->key) == hash &&
-               memcmp(entry->key, chars, length) == 0) {
-      return entry->key;
-    }
-
-    index = (index + 1) & (table->capacity - 1);
-  }
-}
\ No newline at end of file
+  return findEntry(table->entries, table->capacity, chars, length, hash)->key;
+}
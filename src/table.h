@@ -1,4 +1,3 @@
-
 /**
  * @file table.h
  * @author Devin Arena
@@ -11,41 +10,78 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
 
 #define HASH_STRING(str) hashString(str, strlen(str))
 
+// keys are interned, the table owns a copy of each, and their hash and
+// length are kept so probing and growing never look at the characters
 typedef struct {
-  char* key;
-  char* value;
+  const char* key;
+  uint32_t length;
+  uint32_t hash;
+  void* value;
 } Entry;
 
 typedef struct Table {
   int count;
   int capacity;
   Entry* entries;
+  // the characters of every key, NUL terminated
+  Arena keys;
+  // bytes of keys that were deleted, reclaimed once they are most of the
+  // arena
+  size_t deadKeyBytes;
+  size_t liveKeyBytes;
 } Table;
 
 void initTable(Table* table);
 void freeTable(Table* table);
-char* tableGet(Table* table, char* key);
-bool tableSet(Table* table, char* key, char* value);
-bool tableDelete(Table* table, char* key);
+void clearTable(Table* table);
+void* tableGet(Table* table, const char* key);
+void* tableGetString(Table* table, const char* chars, int length);
+bool tableSet(Table* table, const char* key, void* value);
+bool tableSetString(Table* table, const char* chars, int length, void* value);
+bool tableDelete(Table* table, const char* key);
 void tableAddAll(Table* from, Table* to);
-char* tableFindString(Table* table,
-                      const char* chars,
-                      int length,
-                      uint32_t hash);
+const char* tableFindString(Table* table,
+                            const char* chars,
+                            int length,
+                            uint32_t hash);
 
+/**
+ * @brief Hashes a string a word at a time, loading eight bytes per step
+ * rather than mixing in one.
+ *
+ * @param key const char* the characters to hash.
+ * @param length int the number of characters.
+ * @return uint32_t the hash, well mixed in its low bits.
+ */
 static inline uint32_t hashString(const char* key, int length) {
-  uint32_t hash = 2166136261u;
-  for (int i = 0; i < length; i++) {
-    hash ^= key[i];
-    hash *= 16777619;
+  uint64_t hash = 0x9e3779b97f4a7c15ull ^ (uint64_t)length;
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, key + i, 8);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 29;
+  }
+  if (i < length) {
+    // the tail is gathered bytewise, a variable length memcpy is a call
+    uint64_t word = 0;
+    for (int shift = 0; i < length; i++, shift += 8)
+      word |= (uint64_t)(unsigned char)key[i] << shift;
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 29;
   }
-  return hash;
+  // the multiply only carries upwards, the top half is the well mixed one
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  return (uint32_t)(hash >> 32);
 }
 
 // void tableRemoveWhite(Table* table);
 // void markTable(Table* table);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,222 @@
+/**
+ * @file template.c
+ * @author Devin Arena
+ * @brief Writes compiled documents as precompiled templates and renders
+ * them back. Everything that does not depend on the source is rendered
+ * ahead of time, so loading a template is a bounds check and rendering it
+ * is a series of copies.
+ * @since 11/30/2022
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emitter.h"
+#include "hash.h"
+#include "template.h"
+
+// longest a single html record is allowed to grow, leaving room for the
+// tags around a node
+#define MAX_RECORD_LENGTH (UINT32_MAX - 256)
+
+/**
+ * @brief Initializes an empty template writer.
+ *
+ * @param writer TemplateWriter* the writer to initialize.
+ */
+void initTemplateWriter(TemplateWriter* writer) {
+  initBuilder(&writer->data);
+  initMemorySink(&writer->sink, &writer->data);
+  writer->records = NULL;
+  writer->recordCount = 0;
+  writer->recordCapacity = 0;
+  writer->htmlLength = 0;
+}
+
+/**
+ * @brief Frees the memory owned by a template writer.
+ *
+ * @param writer TemplateWriter* the writer to free.
+ */
+void freeTemplateWriter(TemplateWriter* writer) {
+  freeBuilder(&writer->data);
+  free(writer->records);
+  initTemplateWriter(writer);
+}
+
+/**
+ * @brief Appends an empty record starting at the end of the data.
+ *
+ * @param writer TemplateWriter* the writer to append to.
+ * @param type RecordType the record's type.
+ * @return TemplateRecord* the new record.
+ */
+static TemplateRecord* addRecord(TemplateWriter* writer, RecordType type) {
+  if (writer->recordCount == writer->recordCapacity) {
+    writer->recordCapacity =
+        writer->recordCapacity < 64 ? 64 : writer->recordCapacity * 2;
+    writer->records = realloc(writer->records, sizeof(TemplateRecord) *
+                                                   writer->recordCapacity);
+  }
+
+  TemplateRecord* record = &writer->records[writer->recordCount++];
+  record->type = type;
+  record->length = 0;
+  record->offset = writer->data.length;
+  return record;
+}
+
+/**
+ * @brief Appends a record holding a copy of some characters.
+ *
+ * @param writer TemplateWriter* the writer to append to.
+ * @param type RecordType the record's type.
+ * @param chars const char* the record's data.
+ * @param length size_t the length of the data.
+ */
+static void addDataRecord(TemplateWriter* writer,
+                          RecordType type,
+                          const char* chars,
+                          size_t length) {
+  TemplateRecord* record = addRecord(writer, type);
+  builderAppend(&writer->data, chars, length);
+  record->length = length;
+}
+
+/**
+ * @brief Renders a list of nodes into the template. Consecutive nodes become
+ * a single html record, macro calls are recorded between them.
+ *
+ * @param writer TemplateWriter* the writer to append to.
+ * @param node const Node* the first node of the list.
+ */
+void writeTemplateNodes(TemplateWriter* writer, const Node* node) {
+  for (; node != NULL; node = node->next) {
+    if (node->type == NODE_MACRO) {
+      addDataRecord(writer, RECORD_MACRO, node->chars, node->length);
+      continue;
+    }
+
+    TemplateRecord* record = writer->recordCount > 0
+                                 ? &writer->records[writer->recordCount - 1]
+                                 : NULL;
+    if (record == NULL || record->type != RECORD_HTML ||
+        record->length > MAX_RECORD_LENGTH - emittedNodeLength(node))
+      record = addRecord(writer, RECORD_HTML);
+
+    size_t before = writer->data.length;
+    emitNode(node, &writer->sink);
+    record->length += writer->data.length - before;
+    writer->htmlLength += writer->data.length - before;
+  }
+}
+
+/**
+ * @brief Records a file the document referenced.
+ *
+ * @param writer TemplateWriter* the writer to append to.
+ * @param path const char* the path, as written in the source.
+ */
+void writeTemplateDependency(TemplateWriter* writer, const char* path) {
+  addDataRecord(writer, RECORD_DEPENDENCY, path, strlen(path));
+}
+
+/**
+ * @brief Writes the finished template to a sink.
+ *
+ * @param writer TemplateWriter* the writer holding the template.
+ * @param output Sink* where to write the template.
+ */
+void finishTemplate(TemplateWriter* writer, Sink* output) {
+  size_t recordsLength = sizeof(TemplateRecord) * writer->recordCount;
+
+  TemplateHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TEMPLATE_MAGIC, sizeof(header.magic));
+  header.version = TEMPLATE_VERSION;
+  header.byteOrder = TEMPLATE_BYTE_ORDER;
+  header.recordCount = writer->recordCount;
+  header.dataLength = writer->data.length;
+  header.htmlLength = writer->htmlLength;
+  header.checksum = hash64(HASH64_SEED, writer->records, recordsLength);
+
+  sinkWrite(output, (const char*)&header, sizeof(header));
+  sinkWrite(output, (const char*)writer->records, recordsLength);
+  sinkWrite(output, writer->data.chars, writer->data.length);
+}
+
+/**
+ * @brief Checks that a buffer holds a valid template and points the template
+ * into it. The buffer must stay alive and unchanged while the template is
+ * used.
+ *
+ * @param template Template* the template to fill in.
+ * @param chars const char* the template's bytes, 8 byte aligned (as mapped
+ * or allocated memory is).
+ * @param length size_t the number of bytes.
+ * @return const char* NULL if the template is valid, otherwise what is wrong
+ * with it.
+ */
+const char* loadTemplate(Template* template, const char* chars,
+                         size_t length) {
+  if ((uintptr_t)chars % _Alignof(TemplateHeader) != 0)
+    return "Template is not aligned in memory";
+  if (length < sizeof(TemplateHeader))
+    return "Not a compiled template";
+
+  const TemplateHeader* header = (const TemplateHeader*)chars;
+  if (memcmp(header->magic, TEMPLATE_MAGIC, sizeof(header->magic)) != 0)
+    return "Not a compiled template";
+  if (header->byteOrder != TEMPLATE_BYTE_ORDER)
+    return "Template was compiled on a machine with another byte order";
+  if (header->version != TEMPLATE_VERSION)
+    return "Template was compiled by an incompatible version";
+
+  size_t available = length - sizeof(TemplateHeader);
+  if (header->recordCount > available / sizeof(TemplateRecord))
+    return "Template is truncated";
+  size_t recordsLength = sizeof(TemplateRecord) * header->recordCount;
+  if (header->dataLength > available - recordsLength)
+    return "Template is truncated";
+  if (header->dataLength < available - recordsLength)
+    return "Template has trailing data";
+
+  const TemplateRecord* records =
+      (const TemplateRecord*)(chars + sizeof(TemplateHeader));
+  if (hash64(HASH64_SEED, records, recordsLength) != header->checksum)
+    return "Template is corrupt";
+
+  uint64_t htmlLength = 0;
+  for (uint32_t i = 0; i < header->recordCount; i++) {
+    const TemplateRecord* record = &records[i];
+    if (record->type > RECORD_DEPENDENCY ||
+        record->offset > header->dataLength ||
+        record->length > header->dataLength - record->offset)
+      return "Template is corrupt";
+    if (record->type == RECORD_HTML)
+      htmlLength += record->length;
+  }
+  if (htmlLength != header->htmlLength)
+    return "Template is corrupt";
+
+  template->header = header;
+  template->records = records;
+  template->data = (const char*)records + recordsLength;
+  return NULL;
+}
+
+/**
+ * @brief Renders a loaded template's HTML to a sink.
+ *
+ * @param template const Template* the template to render.
+ * @param output Sink* where to write the HTML.
+ */
+void renderTemplate(const Template* template, Sink* output) {
+  sinkReserve(output, template->header->htmlLength);
+
+  for (uint32_t i = 0; i < template->header->recordCount; i++) {
+    const TemplateRecord* record = &template->records[i];
+    if (record->type == RECORD_HTML)
+      sinkWrite(output, template->data + record->offset, record->length);
+  }
+}
@@ -0,0 +1,80 @@
+/**
+ * @file template.h
+ * @author Devin Arena
+ * @brief Header for precompiled templates (.chc), documents compiled ahead
+ * of time into HTML spans that render without being parsed again.
+ * @since 11/30/2022
+ **/
+
+#ifndef CHTML_TEMPLATE_H
+#define CHTML_TEMPLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "builder.h"
+#include "ir.h"
+#include "sink.h"
+
+#define TEMPLATE_MAGIC "CHC"
+// bumped whenever the layout below changes, older files are rejected
+#define TEMPLATE_VERSION 1
+// templates are written in the compiling machine's byte order
+#define TEMPLATE_BYTE_ORDER 0x01020304u
+
+typedef enum {
+  // html rendered as is
+  RECORD_HTML,
+  // a macro expanded at this point, the data is its name, renders nothing
+  RECORD_MACRO,
+  // a file the document referenced, the data is its path, renders nothing
+  RECORD_DEPENDENCY,
+} RecordType;
+
+// a template is the header, then its records, then the data they point into
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t recordCount;
+  uint64_t dataLength;
+  // the length of the rendered document, memory sinks are sized once
+  uint64_t htmlLength;
+  // FNV-1a of the records, their spans are bounds checked on load
+  uint64_t checksum;
+} TemplateHeader;
+
+// offsets are relative to the data, so a template can be loaded anywhere
+typedef struct {
+  uint32_t type;
+  uint32_t length;
+  uint64_t offset;
+} TemplateRecord;
+
+typedef struct {
+  StringBuilder data;
+  // writes straight through into data
+  Sink sink;
+  TemplateRecord* records;
+  uint32_t recordCount;
+  uint32_t recordCapacity;
+  uint64_t htmlLength;
+} TemplateWriter;
+
+// a loaded template, pointing into memory owned by the caller
+typedef struct {
+  const TemplateHeader* header;
+  const TemplateRecord* records;
+  const char* data;
+} Template;
+
+void initTemplateWriter(TemplateWriter* writer);
+void freeTemplateWriter(TemplateWriter* writer);
+void writeTemplateNodes(TemplateWriter* writer, const Node* node);
+void writeTemplateDependency(TemplateWriter* writer, const char* path);
+void finishTemplate(TemplateWriter* writer, Sink* output);
+const char* loadTemplate(Template* template, const char* chars, size_t length);
+void renderTemplate(const Template* template, Sink* output);
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file timer.h
+ * @author Devin Arena
+ * @brief Monotonic clock used for build timings.
+ * @since 11/24/2022
+ **/
+
+#ifndef CHTML_TIMER_H
+#define CHTML_TIMER_H
+
+#include <time.h>
+
+/**
+ * @brief Returns a monotonic timestamp in milliseconds.
+ *
+ * @return double the current time.
+ */
+static inline double clockMillis() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+#endif
@@ -0,0 +1,183 @@
+/**
+ * @file tokens.c
+ * @author Devin Arena
+ * @brief Lexes a whole in-memory document up front into a compact
+ * struct-of-arrays token buffer, which the compiler then walks.
+ * @since 11/28/2022
+ **/
+
+#include <stdlib.h>
+
+#include "tokens.h"
+
+/**
+ * @brief Zeroes out a token buffer.
+ *
+ * @param buffer TokenBuffer* the buffer to initialize.
+ */
+void initTokenBuffer(TokenBuffer* buffer) {
+  buffer->source = NULL;
+  buffer->types = NULL;
+  buffer->tabs = NULL;
+  buffer->offsets = NULL;
+  buffer->lengths = NULL;
+  buffer->lines = NULL;
+  buffer->count = 0;
+  buffer->capacity = 0;
+  buffer->definitions = NULL;
+  buffer->definitionCount = 0;
+  buffer->definitionCapacity = 0;
+}
+
+/**
+ * @brief Frees the arrays of a token buffer.
+ *
+ * @param buffer TokenBuffer* the buffer to free.
+ */
+void freeTokenBuffer(TokenBuffer* buffer) {
+  free(buffer->types);
+  free(buffer->tabs);
+  free(buffer->offsets);
+  free(buffer->lengths);
+  free(buffer->lines);
+  free(buffer->definitions);
+  initTokenBuffer(buffer);
+}
+
+/**
+ * @brief Appends a token, growing every array together.
+ *
+ * @param buffer TokenBuffer* the buffer to append to.
+ * @param token Token the token, its text must lie in buffer->source.
+ */
+static void addToken(TokenBuffer* buffer, Token token) {
+  if (buffer->count == buffer->capacity) {
+    buffer->capacity = buffer->capacity < 256 ? 256 : buffer->capacity * 2;
+    buffer->types = realloc(buffer->types, buffer->capacity);
+    buffer->tabs = realloc(buffer->tabs, sizeof(uint32_t) * buffer->capacity);
+    buffer->offsets =
+        realloc(buffer->offsets, sizeof(uint32_t) * buffer->capacity);
+    buffer->lengths =
+        realloc(buffer->lengths, sizeof(uint32_t) * buffer->capacity);
+    buffer->lines = realloc(buffer->lines, sizeof(uint32_t) * buffer->capacity);
+  }
+
+  int index = buffer->count++;
+  buffer->types[index] = token.type;
+  buffer->tabs[index] = token.tab;
+  buffer->offsets[index] = token.start - buffer->source;
+  buffer->lengths[index] = token.length;
+  buffer->lines[index] = token.line;
+}
+
+/**
+ * @brief Records how many definitions a TOKEN_MACRO makes visible.
+ *
+ * @param buffer TokenBuffer* the buffer.
+ * @param count int the scanner's definition count after the token.
+ */
+static void addDefinitions(TokenBuffer* buffer, int count) {
+  if (buffer->definitionCount == buffer->definitionCapacity) {
+    buffer->definitionCapacity =
+        buffer->definitionCapacity < 8 ? 8 : buffer->definitionCapacity * 2;
+    buffer->definitions = realloc(buffer->definitions,
+                                  sizeof(int) * buffer->definitionCapacity);
+  }
+  buffer->definitions[buffer->definitionCount++] = count;
+}
+
+/**
+ * @brief Lexes everything left in an in-memory scanner into the buffer,
+ * replacing what it held. The buffer always ends in TOKEN_EOF, lexing stops
+ * early after a token the compiler is bound to reject.
+ *
+ * @param buffer TokenBuffer* the buffer to fill.
+ * @param scanner Scanner* a scanner over an in-memory source.
+ * @return bool false if the source is streamed or too large for 32-bit
+ * offsets.
+ */
+bool tokenize(TokenBuffer* buffer, Scanner* scanner) {
+  if (scanner->source == NULL ||
+      (uint64_t)(scanner->end - scanner->source) > UINT32_MAX)
+    return false;
+
+  buffer->source = scanner->source;
+  buffer->count = 0;
+  buffer->definitionCount = 0;
+
+  while (true) {
+    Token token = scanToken(scanner);
+    addToken(buffer, token);
+
+    if (token.type == TOKEN_MACRO)
+      addDefinitions(buffer, scanner->definedCount);
+
+    // errors and empty identifiers do not advance the scanner
+    if (token.type == TOKEN_EOF)
+      break;
+    if (token.type == TOKEN_ERROR ||
+        (token.type == TOKEN_IDENTIFIER && token.length == 0)) {
+      token.type = TOKEN_EOF;
+      token.start += token.length;
+      token.length = 0;
+      addToken(buffer, token);
+      break;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Rebuilds the Token at an index. Past the end, the final TOKEN_EOF
+ * is returned again.
+ *
+ * @param buffer const TokenBuffer* the buffer.
+ * @param index int the token's index.
+ * @return Token the token.
+ */
+Token tokenAt(const TokenBuffer* buffer, int index) {
+  if (index >= buffer->count)
+    index = buffer->count - 1;
+
+  Token token;
+  token.type = (TokenType)buffer->types[index];
+  token.tab = buffer->tabs[index];
+  token.start = buffer->source + buffer->offsets[index];
+  token.length = buffer->lengths[index];
+  token.line = buffer->lines[index];
+  token.col = 0;
+  return token;
+}
+
+/**
+ * @brief Writes one line per token: index, line, tab depth, type and text.
+ *
+ * @param buffer const TokenBuffer* the buffer to dump.
+ * @param file FILE* where to write.
+ */
+void dumpTokens(const TokenBuffer* buffer, FILE* file) {
+  for (int i = 0; i < buffer->count; i++) {
+    Token token = tokenAt(buffer, i);
+    fprintf(file, "%6d %5d %3d %-12s ", i, token.line, token.tab,
+            tokenTypeName(token.type));
+
+    // keep one token per line, multi-line text is escaped
+    for (int c = 0; c < token.length; c++) {
+      switch (token.start[c]) {
+        case '\n':
+          fputs("\\n", file);
+          break;
+        case '\r':
+          fputs("\\r", file);
+          break;
+        case '\t':
+          fputs("\\t", file);
+          break;
+        default:
+          fputc(token.start[c], file);
+          break;
+      }
+    }
+    fputc('\n', file);
+  }
+}
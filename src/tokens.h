@@ -0,0 +1,40 @@
+/**
+ * @file tokens.h
+ * @author Devin Arena
+ * @brief Header for the token buffer.
+ * @since 11/28/2022
+ **/
+
+#ifndef CHTML_TOKENS_H
+#define CHTML_TOKENS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "scanner.h"
+
+// a whole document's tokens, one array per field
+typedef struct {
+  const char* source;
+  uint8_t* types;
+  uint32_t* tabs;
+  uint32_t* offsets;
+  uint32_t* lengths;
+  // errors and same-line checks (css paths) need the line
+  uint32_t* lines;
+  int count;
+  int capacity;
+  // for each TOKEN_MACRO in order, how many of the scanner's definitions
+  // exist once the compiler reaches it
+  int* definitions;
+  int definitionCount;
+  int definitionCapacity;
+} TokenBuffer;
+
+void initTokenBuffer(TokenBuffer* buffer);
+void freeTokenBuffer(TokenBuffer* buffer);
+bool tokenize(TokenBuffer* buffer, Scanner* scanner);
+Token tokenAt(const TokenBuffer* buffer, int index);
+void dumpTokens(const TokenBuffer* buffer, FILE* file);
+
+#endif
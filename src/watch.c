@@ -0,0 +1,404 @@
+/**
+ * @file watch.c
+ * @author Devin Arena
+ * @brief Watch mode. Builds a file or directory once, then uses inotify to
+ * rebuild only the pages whose source or referenced files (css) changed.
+ * Directories are watched rather than files, since editors usually save by
+ * renaming a new file over the old one.
+ * @since 11/24/2022
+ **/
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chtml.h"
+#include "path.h"
+#include "site.h"
+#include "timer.h"
+#include "watch.h"
+
+// quiet period that ends a burst of writes before rebuilding
+#define DEBOUNCE_MS 30
+
+#define WATCH_EVENTS                                                \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | \
+   IN_DELETE)
+
+typedef struct {
+  char* input;
+  char** dependencies;
+  int dependencyCount;
+  bool dirty;
+} WatchedPage;
+
+typedef struct {
+  int wd;
+  char* path;
+  // path relative to the input root, NULL for directories only watched for
+  // dependencies
+  char* relative;
+} WatchedDir;
+
+typedef struct {
+  int fd;
+  const char* inputDir;
+  const char* outputDir;
+  Site site;
+  WatchedPage* pages;
+  int pageCapacity;
+  WatchedDir* dirs;
+  int dirCount;
+  int dirCapacity;
+  ChtmlContext* context;
+  Stats* stats;
+  bool statsJson;
+} Watcher;
+
+/**
+ * @brief Starts watching a directory if it isn't watched already.
+ *
+ * @param watcher Watcher* the watcher.
+ * @param path const char* the canonical directory path.
+ * @param relative const char* the path relative to the input root, or NULL.
+ */
+static void watchDir(Watcher* watcher, const char* path,
+                     const char* relative) {
+  for (int i = 0; i < watcher->dirCount; i++) {
+    WatchedDir* dir = &watcher->dirs[i];
+    if (strcmp(dir->path, path) != 0)
+      continue;
+    if (dir->relative == NULL && relative != NULL)
+      dir->relative = strdup(relative);
+    return;
+  }
+
+  int wd = inotify_add_watch(watcher->fd, path, WATCH_EVENTS);
+  if (wd < 0) {
+    fprintf(stderr, "Could not watch '%s': %s\n", path, strerror(errno));
+    return;
+  }
+
+  if (watcher->dirCount == watcher->dirCapacity) {
+    watcher->dirCapacity =
+        watcher->dirCapacity < 8 ? 8 : watcher->dirCapacity * 2;
+    watcher->dirs =
+        realloc(watcher->dirs, sizeof(WatchedDir) * watcher->dirCapacity);
+  }
+
+  WatchedDir* dir = &watcher->dirs[watcher->dirCount++];
+  dir->wd = wd;
+  dir->path = strdup(path);
+  dir->relative = relative != NULL ? strdup(relative) : NULL;
+}
+
+/**
+ * @brief Watches the directory containing a canonical file path.
+ *
+ * @param watcher Watcher* the watcher.
+ * @param path const char* the canonical file path.
+ */
+static void watchParent(Watcher* watcher, const char* path) {
+  const char* slash = strrchr(path, '/');
+  char* dir = slash == path ? strdup("/") : strndup(path, slash - path);
+  watchDir(watcher, dir, NULL);
+  free(dir);
+}
+
+/**
+ * @brief Keeps the watched page list in step with the site's pages.
+ *
+ * @param watcher Watcher* the watcher.
+ */
+static void syncPages(Watcher* watcher) {
+  if (watcher->site.count > watcher->pageCapacity) {
+    int capacity = watcher->site.capacity;
+    watcher->pages = realloc(watcher->pages, sizeof(WatchedPage) * capacity);
+    for (int i = watcher->pageCapacity; i < capacity; i++) {
+      watcher->pages[i].input = NULL;
+      watcher->pages[i].dependencies = NULL;
+      watcher->pages[i].dependencyCount = 0;
+      watcher->pages[i].dirty = false;
+    }
+    watcher->pageCapacity = capacity;
+  }
+
+  for (int i = 0; i < watcher->site.count; i++) {
+    WatchedPage* page = &watcher->pages[i];
+    if (page->input != NULL)
+      continue;
+    page->input = canonicalPath(watcher->site.pages[i].input);
+    page->dirty = true;
+  }
+}
+
+/**
+ * @brief Compiles one page with the watcher's warm context and records the
+ * files it referenced.
+ *
+ * @param watcher Watcher* the watcher.
+ * @param index int the page to compile.
+ */
+static void compileWatched(Watcher* watcher, int index) {
+  Page* page = &watcher->site.pages[index];
+  WatchedPage* watched = &watcher->pages[index];
+  watched->dirty = false;
+
+  char* slash = strrchr(page->output, '/');
+  if (slash != NULL) {
+    *slash = '\0';
+    makeDirectories(page->output);
+    *slash = '/';
+  }
+
+  double start = clockMillis();
+  page->ok = chtmlCompileFile(watcher->context, page->input, page->output);
+  page->millis = clockMillis() - start;
+
+  if (!page->ok) {
+    printf("%10.3f ms  %s  FAILED: %s\n", page->millis, page->relative,
+           chtmlError(watcher->context));
+    return;
+  }
+  printf("%10.3f ms  %s\n", page->millis, page->relative);
+
+  for (int i = 0; i < watched->dependencyCount; i++)
+    free(watched->dependencies[i]);
+  free(watched->dependencies);
+
+  int count = chtmlDependencyCount(watcher->context);
+  watched->dependencies = malloc(sizeof(char*) * (count + 1));
+  watched->dependencyCount = 0;
+  for (int i = 0; i < count; i++) {
+    const char* dependency = chtmlDependency(watcher->context, i);
+    char* resolved = resolvePath(page->input, dependency, strlen(dependency));
+    char* canonical = canonicalPath(resolved);
+    free(resolved);
+    if (canonical == NULL)
+      continue;
+
+    watchParent(watcher, canonical);
+    watched->dependencies[watched->dependencyCount++] = canonical;
+  }
+}
+
+/**
+ * @brief Recompiles every dirty page and reports how long it took.
+ *
+ * @param watcher Watcher* the watcher.
+ * @param changed double when the first change of the burst was seen.
+ */
+static void rebuild(Watcher* watcher, double changed) {
+  double start = clockMillis();
+  int count = 0;
+  for (int i = 0; i < watcher->site.count; i++) {
+    if (!watcher->pages[i].dirty)
+      continue;
+    compileWatched(watcher, i);
+    count++;
+  }
+
+  if (count == 0)
+    return;
+
+  double end = clockMillis();
+  printf("Rebuilt %d page(s) in %.3f ms (%.3f ms after the first change)\n",
+         count, end - start, end - changed);
+  fflush(stdout);
+
+  // each rebuild is reported on its own
+  if (watcher->stats != NULL) {
+    printStats(watcher->stats, stderr, watcher->statsJson);
+    initStats(watcher->stats);
+  }
+}
+
+/**
+ * @brief Marks the pages affected by a change to a file.
+ *
+ * @param watcher Watcher* the watcher.
+ * @param dir WatchedDir* the directory the change happened in.
+ * @param event struct inotify_event* the change.
+ */
+static void handleEvent(Watcher* watcher, WatchedDir* dir,
+                        struct inotify_event* event) {
+  if (event->len == 0)
+    return;
+
+  char* path = joinPath(dir->path, event->name);
+  bool created = event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE);
+
+  // new directories inside the input tree bring their pages with them
+  if (event->mask & IN_ISDIR) {
+    if (dir->relative != NULL && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+      char* relative = joinPath(dir->relative, event->name);
+      watchDir(watcher, path, relative);
+      collectSitePages(&watcher->site, watcher->inputDir, watcher->outputDir,
+                       relative);
+      syncPages(watcher);
+      free(relative);
+    }
+    free(path);
+    return;
+  }
+
+  bool known = false;
+  for (int i = 0; i < watcher->site.count; i++) {
+    WatchedPage* page = &watcher->pages[i];
+    if (page->input != NULL && strcmp(page->input, path) == 0) {
+      page->dirty = true;
+      known = true;
+      continue;
+    }
+    for (int j = 0; j < page->dependencyCount; j++) {
+      if (strcmp(page->dependencies[j], path) == 0)
+        page->dirty = true;
+    }
+  }
+
+  if (!known && created && dir->relative != NULL &&
+      isSourceFile(event->name)) {
+    char* relative = joinPath(dir->relative, event->name);
+    char* input = joinPath(watcher->inputDir, relative);
+    addSitePage(&watcher->site, watcher->outputDir, input, relative, 0);
+    syncPages(watcher);
+    free(relative);
+  }
+
+  free(path);
+}
+
+/**
+ * @brief Reads all pending inotify events.
+ *
+ * @param watcher Watcher* the watcher.
+ * @return bool false if reading failed.
+ */
+static bool readEvents(Watcher* watcher) {
+  char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+  if (length < 0)
+    return errno == EINTR || errno == EAGAIN;
+
+  for (char* c = buffer; c < buffer + length;) {
+    struct inotify_event* event = (struct inotify_event*)c;
+    for (int i = 0; i < watcher->dirCount; i++) {
+      if (watcher->dirs[i].wd == event->wd) {
+        handleEvent(watcher, &watcher->dirs[i], event);
+        break;
+      }
+    }
+    c += sizeof(struct inotify_event) + event->len;
+  }
+  return true;
+}
+
+/**
+ * @brief Builds a file (or every .ch file in a directory) and keeps rebuilding
+ * changed pages until interrupted.
+ *
+ * @param input const char* the source file or directory.
+ * @param output const char* the output file or directory.
+ * @param context ChtmlContext* the configured context every page is compiled
+ * with, kept warm between rebuilds.
+ * @param stats Stats* the stats the context adds to, printed and reset after
+ * each rebuild, may be NULL.
+ * @param statsJson bool whether to print the stats as JSON.
+ * @return int the process exit code.
+ */
+int watchBuild(const char* input,
+               const char* output,
+               ChtmlContext* context,
+               Stats* stats,
+               bool statsJson) {
+  Watcher watcher;
+  memset(&watcher, 0, sizeof(watcher));
+  watcher.inputDir = input;
+  watcher.outputDir = output;
+  watcher.context = context;
+  watcher.stats = stats;
+  watcher.statsJson = statsJson;
+
+  watcher.fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (watcher.fd < 0) {
+    fprintf(stderr, "Could not start inotify: %s\n", strerror(errno));
+    return 1;
+  }
+
+  struct stat info;
+  if (stat(input, &info) != 0) {
+    fprintf(stderr, "Could not read '%s': %s\n", input, strerror(errno));
+    return 74;
+  }
+
+  if (S_ISDIR(info.st_mode)) {
+    char* root = canonicalPath(input);
+    watchDir(&watcher, root, "");
+    free(root);
+    collectSitePages(&watcher.site, input, output, "");
+
+    // directories inside the tree, so new pages are picked up
+    for (int i = 0; i < watcher.site.count; i++) {
+      char* canonical = canonicalPath(watcher.site.pages[i].input);
+      const char* relative = watcher.site.pages[i].relative;
+      const char* slash = strrchr(relative, '/');
+      if (slash != NULL) {
+        char* dir = strndup(canonical, strrchr(canonical, '/') - canonical);
+        char* relativeDir = strndup(relative, slash - relative);
+        watchDir(&watcher, dir, relativeDir);
+        free(dir);
+        free(relativeDir);
+      }
+      free(canonical);
+    }
+  } else {
+    watcher.site.pages = malloc(sizeof(Page));
+    watcher.site.capacity = 1;
+    watcher.site.count = 1;
+    Page* page = &watcher.site.pages[0];
+    memset(page, 0, sizeof(Page));
+    page->input = strdup(input);
+    page->output = strdup(output);
+    page->relative = strdup(input);
+
+    char* canonical = canonicalPath(input);
+    watchParent(&watcher, canonical);
+    free(canonical);
+  }
+
+  syncPages(&watcher);
+  rebuild(&watcher, clockMillis());
+  printf("Watching for changes, press Ctrl-C to stop\n");
+  fflush(stdout);
+
+  struct pollfd poller = {watcher.fd, POLLIN, 0};
+  while (true) {
+    if (poll(&poller, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    double changed = clockMillis();
+    if (!readEvents(&watcher))
+      break;
+
+    // let a burst of writes (save, format, touch) settle into one rebuild
+    while (poll(&poller, 1, DEBOUNCE_MS) > 0) {
+      if (!readEvents(&watcher))
+        break;
+    }
+
+    rebuild(&watcher, changed);
+  }
+
+  fprintf(stderr, "Stopped watching: %s\n", strerror(errno));
+  close(watcher.fd);
+  return 1;
+}
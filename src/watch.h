@@ -0,0 +1,22 @@
+/**
+ * @file watch.h
+ * @author Devin Arena
+ * @brief Header for watch mode.
+ * @since 11/24/2022
+ **/
+
+#ifndef CHTML_WATCH_H
+#define CHTML_WATCH_H
+
+#include <stdbool.h>
+
+#include "chtml.h"
+#include "stats.h"
+
+int watchBuild(const char* input,
+               const char* output,
+               ChtmlContext* context,
+               Stats* stats,
+               bool statsJson);
+
+#endif
@@ -0,0 +1,251 @@
+/**
+ * @file memory.c
+ * @author Devin Arena
+ * @brief Checks that compiles leave no allocations behind. The test is
+ * linked with malloc, calloc, realloc and free wrapped, so every heap
+ * allocation libchtml makes is counted.
+ * @since 12/2/2022
+ **/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/chtml.h"
+
+#define ROUNDS 10000
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void __real_free(void* pointer);
+
+// allocations made and not yet freed
+static long outstanding = 0;
+// allocations made in total
+static long allocations = 0;
+
+void* __wrap_malloc(size_t size) {
+  void* pointer = __real_malloc(size);
+  if (pointer != NULL) {
+    __atomic_add_fetch(&outstanding, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+  }
+  return pointer;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  void* pointer = __real_calloc(count, size);
+  if (pointer != NULL) {
+    __atomic_add_fetch(&outstanding, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+  }
+  return pointer;
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+  void* grown = __real_realloc(pointer, size);
+  if (pointer == NULL && grown != NULL) {
+    __atomic_add_fetch(&outstanding, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+  }
+  return grown;
+}
+
+void __wrap_free(void* pointer) {
+  if (pointer != NULL)
+    __atomic_sub_fetch(&outstanding, 1, __ATOMIC_RELAXED);
+  __real_free(pointer);
+}
+
+static const char* document =
+    "@card\n"
+    "\tcon(\"padding: 4px\")\n"
+    "@note\n"
+    "\tp \"a note\"\n"
+    "document\n"
+    "\thead\n"
+    "\t\ttitle !pi\n"
+    "\t\tcss \"./test.css\"\n"
+    "\t\tcss \"./print.css\"\n"
+    "\tbody\n"
+    "\t\t!card\n"
+    "\t\t\th1 \"heading\"\n"
+    "\t\t\t!note\n"
+    "\t\tp \"text\"\n"
+    "\t\t`<div>raw</div>`\n";
+
+static const char* broken =
+    "@card\n"
+    "\tcon(\"padding: 4px\")\n"
+    "document\n"
+    "\tbody\n"
+    "\t\t!card\n"
+    "\t\t\t!missing\n";
+
+static int failures = 0;
+
+/**
+ * @brief Reports a failed check.
+ *
+ * @param ok whether the check passed.
+ * @param name what was checked.
+ */
+static void check(bool ok, const char* name) {
+  if (!ok) {
+    fprintf(stderr, "FAIL %s (%ld outstanding)\n", name, outstanding);
+    failures++;
+  }
+}
+
+/**
+ * @brief Writes a sink's output nowhere.
+ */
+static bool discard(void* userData, const char* chars, size_t length) {
+  (void)userData;
+  (void)chars;
+  (void)length;
+  return true;
+}
+
+/**
+ * @brief Compiles a document many times on one context, checking that the
+ * context stops allocating once it has warmed up.
+ *
+ * @param name what is being compiled.
+ * @param source the document.
+ * @param jobs threads to compile with.
+ * @param succeeds whether the document compiles.
+ */
+static void repeatCompile(const char* name,
+                          const char* source,
+                          int jobs,
+                          bool succeeds) {
+  long before = outstanding;
+  ChtmlContext* context = chtmlCreate();
+  chtmlSetJobs(context, jobs);
+
+  long warm = 0;
+  long warmAllocations = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    bool ok = chtmlCompileString(context, source, strlen(source));
+    if (ok != succeeds) {
+      check(false, name);
+      break;
+    }
+    if (round == 1) {
+      warm = outstanding;
+      warmAllocations = allocations;
+    }
+  }
+
+  char label[128];
+  snprintf(label, sizeof(label), "%s: flat across compiles", name);
+  check(outstanding == warm, label);
+  if (jobs == 1) {
+    snprintf(label, sizeof(label), "%s: no allocations once warm", name);
+    check(allocations == warmAllocations, label);
+  }
+
+  chtmlDestroy(context);
+  snprintf(label, sizeof(label), "%s: nothing left after teardown", name);
+  check(outstanding == before, label);
+}
+
+/**
+ * @brief Streams a document through a pipe.
+ */
+static void streamCompile() {
+  long before = outstanding;
+  ChtmlContext* context = chtmlCreate();
+
+  for (int round = 0; round < 100; round++) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      check(false, "stream: pipe");
+      break;
+    }
+    write(fds[1], document, strlen(document));
+    close(fds[1]);
+
+    Sink output;
+    initCallbackSink(&output, discard, NULL);
+    check(chtmlCompileStream(context, fds[0], &output), "stream: compile");
+    close(fds[0]);
+  }
+
+  chtmlDestroy(context);
+  check(outstanding == before, "stream: nothing left after teardown");
+}
+
+/**
+ * @brief Compiles a template and renders it back.
+ */
+static void templateRoundTrip() {
+  long before = outstanding;
+  ChtmlContext* context = chtmlCreate();
+
+  StringBuilder compiled;
+  initBuilder(&compiled);
+  Sink output;
+  initMemorySink(&output, &compiled);
+  check(chtmlCompileTemplate(context, document, strlen(document), &output),
+        "template: compile");
+
+  for (int round = 0; round < 100; round++) {
+    initCallbackSink(&output, discard, NULL);
+    check(chtmlRenderTemplate(context, compiled.chars, compiled.length,
+                              &output),
+          "template: render");
+  }
+  check(chtmlDependencyCount(context) == 2, "template: dependencies");
+
+  freeBuilder(&compiled);
+  chtmlDestroy(context);
+  check(outstanding == before, "template: nothing left after teardown");
+}
+
+/**
+ * @brief Builds a document large enough to be split across threads.
+ */
+static char* largeDocument() {
+  StringBuilder source;
+  initBuilder(&source);
+  builderAppendString(&source, document);
+  for (int i = 0; i < 4000; i++)
+    builderAppendString(&source,
+                        "\t\tcontainer\n"
+                        "\t\t\t!card\n"
+                        "\t\t\t\th2 \"card\"\n"
+                        "\t\t\t\tp \"text\"\n"
+                        "\t\t\t\tcss \"./card.css\"\n");
+  return source.chars;
+}
+
+int main() {
+  // the built in macros are loaded once per process, by the first context
+  chtmlDestroy(chtmlCreate());
+
+  repeatCompile("document", document, 1, true);
+  repeatCompile("error", broken, 1, false);
+  streamCompile();
+  templateRoundTrip();
+
+  char* large = largeDocument();
+  long before = outstanding;
+  ChtmlContext* context = chtmlCreate();
+  chtmlSetJobs(context, 4);
+  for (int round = 0; round < 20; round++)
+    check(chtmlCompileString(context, large, strlen(large)),
+          "parallel: compile");
+  check(chtmlDependencyCount(context) == 3, "parallel: dependencies");
+  chtmlDestroy(context);
+  check(outstanding == before, "parallel: nothing left after teardown");
+  free(large);
+
+  if (failures == 0)
+    printf("memory: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
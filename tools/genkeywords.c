@@ -0,0 +1,115 @@
+/**
+ * @file genkeywords.c
+ * @author Devin Arena
+ * @brief Build tool that searches for a multiplier giving every keyword in
+ * src/keywords.def its own slot, then writes the table as a header.
+ * @since 11/26/2022
+ **/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/keyword.h"
+
+typedef struct {
+  const char* name;
+  const char* type;
+} Entry;
+
+static const Entry entries[] = {
+#define KEYWORD(name, type) {name, #type},
+#include "../src/keywords.def"
+#undef KEYWORD
+};
+
+#define ENTRY_COUNT (int)(sizeof(entries) / sizeof(entries[0]))
+
+/**
+ * @brief Checks whether a seed places every keyword in its own slot.
+ *
+ * @param seed the multiplier to try.
+ * @param bits log2 of the table size.
+ * @param slots filled with the entry index of each slot, -1 when empty.
+ * @return bool true if there were no collisions.
+ */
+static bool tryPlace(uint32_t seed, int bits, int* slots) {
+  for (int i = 0; i < 1 << bits; i++)
+    slots[i] = -1;
+
+  for (int i = 0; i < ENTRY_COUNT; i++) {
+    const char* name = entries[i].name;
+    uint32_t slot = keywordHash(name, strlen(name), seed, bits);
+    if (slots[slot] != -1)
+      return false;
+    slots[slot] = i;
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <output header>\n", argv[0]);
+    return 1;
+  }
+
+  int slots[1 << 10];
+  int bits = 0;
+  while ((1 << bits) < ENTRY_COUNT)
+    bits++;
+
+  uint32_t seed = 0;
+  for (; bits <= 10 && seed == 0; bits++) {
+    // odd multipliers from a fixed sequence, so the output is reproducible
+    uint32_t candidate = 0x9e3779b9u;
+    for (int attempt = 0; attempt < 1000000; attempt++) {
+      if (tryPlace(candidate | 1, bits, slots)) {
+        seed = candidate | 1;
+        break;
+      }
+      candidate = candidate * 1664525u + 1013904223u;
+    }
+  }
+  bits--;
+
+  if (seed == 0) {
+    fprintf(stderr, "No perfect hash found for %d keywords\n", ENTRY_COUNT);
+    return 1;
+  }
+
+  FILE* file = fopen(argv[1], "w");
+  if (file == NULL) {
+    perror(argv[1]);
+    return 74;
+  }
+
+  int minLength = 255;
+  int maxLength = 0;
+  for (int i = 0; i < ENTRY_COUNT; i++) {
+    int length = strlen(entries[i].name);
+    minLength = length < minLength ? length : minLength;
+    maxLength = length > maxLength ? length : maxLength;
+  }
+
+  fprintf(file, "// generated by tools/genkeywords.c from src/keywords.def\n");
+  fprintf(file, "#ifndef CHTML_KEYWORDS_H\n#define CHTML_KEYWORDS_H\n\n");
+  fprintf(file, "#define KEYWORD_SEED 0x%08xu\n", seed);
+  fprintf(file, "#define KEYWORD_BITS %d\n", bits);
+  fprintf(file, "#define KEYWORD_MIN_LENGTH %d\n", minLength);
+  fprintf(file, "#define KEYWORD_MAX_LENGTH %d\n\n", maxLength);
+  fprintf(file, "static const Keyword keywordTable[%d] = {\n", 1 << bits);
+  for (int i = 0; i < 1 << bits; i++) {
+    if (slots[i] == -1)
+      continue;
+    const Entry* entry = &entries[slots[i]];
+    fprintf(file, "    [%d] = {\"%s\", %d, %s},\n", i, entry->name,
+            (int)strlen(entry->name), entry->type);
+  }
+  fprintf(file, "};\n\n#endif\n");
+
+  if (fclose(file) != 0) {
+    perror(argv[1]);
+    return 74;
+  }
+  return 0;
+}